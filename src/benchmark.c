@@ -0,0 +1,65 @@
+
+#define JSON_IMPLEMENTATION
+#define JSON_USE_SINGLE_BYTE
+#include "json.h"
+
+#include <time.h>
+
+// Parses the same small message over and over, once with json_parse()/json_free() and once with a reused JsonParser
+static const char* message =
+  "{ \"id\": 12345, \"type\": \"trade\", \"symbol\": \"ABC\", \"price\": 101.25, \"size\": 300,"
+  "  \"flags\": [ \"open\", \"lit\" ], \"venue\": { \"name\": \"X\", \"region\": \"eu\" }, \"ack\": true }";
+
+static double seconds_since(clock_t start) {
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main() {
+  const int ITERATIONS = 200000;
+  
+  clock_t start = clock();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    JsonValue json = json_parse(message);
+    json_free(&json);
+  }
+  double fresh = seconds_since(start);
+  
+  JsonParser parser;
+  json_parser_init(&parser);
+  
+  start = clock();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    JsonValue json = json_parser_parse(&parser, message, 0);
+    (void)json;
+    
+    // Everything parsed since the last reset is released at once
+    json_parser_reset(&parser);
+  }
+  double reused = seconds_since(start);
+  
+  json_parser_free(&parser);
+  
+  printf("json_parse + json_free: %8.1f ns/message\n", fresh * 1e9 / ITERATIONS);
+  printf("json_parser_parse:      %8.1f ns/message\n", reused * 1e9 / ITERATIONS);
+  
+#ifdef JSON_ENABLE_STATS
+  JsonStats stats = {};
+  json_set_stats(&stats);
+  
+  JsonValue json = json_parse(message);
+  json_free(&json);
+  
+  json_set_stats(NULL);
+  
+  printf("\n%llu bytes, %llu values, %llu keys, depth %u\n", (unsigned long long)stats.bytes_scanned,
+         (unsigned long long)(stats.values[JSON_NULL] + stats.values[JSON_STRING] + stats.values[JSON_NUMBER] +
+                              stats.values[JSON_OBJECT] + stats.values[JSON_ARRAY] + stats.values[JSON_BOOL]),
+         (unsigned long long)stats.keys, stats.max_depth);
+  printf("%llu allocations (%llu bytes), %llu reallocations, %llu frees\n", (unsigned long long)stats.allocations,
+         (unsigned long long)stats.bytes_allocated, (unsigned long long)stats.reallocations, (unsigned long long)stats.frees);
+  printf("%llu ns numbers, %llu ns strings, %llu ns structure\n", (unsigned long long)stats.number_time,
+         (unsigned long long)stats.string_time, (unsigned long long)stats.structural_time);
+#endif
+  
+  return 0;
+}
@@ -11,9 +11,20 @@
 //  #include "json.h"
 //
 // If you don't want to use malloc/realloc/free you can define #define JSON_MALLOC(size)/JSON_REALLOC(ptr, size)/JSON_FREE(ptr).
-// Note that whenever the parser allocates anything on the heap that it will memset the allocated block to 0.
+// Note that the parser will memset heap-allocated structures (arrays, object nodes, values) to 0.
+// String and element buffers are left uninitialised since they are always written before being read.
 // If you have a custom allocator that returns zeroed memory, you can #define JSON_MEM_ALREADY_ZEROED to avoid memsetting it again.
 //
+// To pick an allocator at runtime instead, e.g. a pool per thread, fill in a JsonAllocator and set it for the current thread:
+//  JsonAllocator pool = { pool_alloc, pool_realloc, pool_free, pool_state };
+//  const JsonAllocator* previous = json_set_allocator(&pool);
+//  ... every JsonValue created, changed or freed on this thread now uses the pool ...
+//  json_set_allocator(previous);
+//
+// json_parse_with(), json_duplicate_with() and json_free_with() set it for a single call.
+// A tree has to be changed and freed with the allocator that built it. Buffers handed back to you
+// (json_stringify_alloc(), json_stringify_canonical(), json_snapshot_build(), CBOR writers, queries and columns) always use JSON_MALLOC.
+//
 // This parser follows the ECMA-404 standard.
 // 
 // License:
@@ -39,15 +50,96 @@
 //
 //   Note that json_parse_from_file() will heap-allocate a string that can hold the value and then call json_parse() on that and free it.
 //
+//   If many numbers are never read or only passed through, json_parse_ex() can skip converting them:
+//     JsonValue json = json_parse_ex(some_text, JSON_PARSE_LAZY_NUMBERS);
+//
+//   Numbers are then JSON_RAW_NUMBER values that point into some_text, so it has to outlive the JsonValue.
+//   json_get_number()/json_get_int64() convert them when read, json_stringify() writes the original literal back out.
+//   json_duplicate() converts them to JSON_NUMBER, so a copy doesn't depend on the text.
+//   Integer literals keep their exact value through json_get_int64(), even beyond 2^53.
+//
+//   JSON_PARSE_NUMBER_ARRAYS stores non-empty arrays that only hold numbers as a JSON_NUMBER_ARRAY, a contiguous
+//   int64_t[] (while every element is an integer) or double[] instead of one JsonValue per element:
+//     JsonValue json = json_parse_ex(some_text, JSON_PARSE_NUMBER_ARRAYS);
+//
+//   Flags can be combined, number arrays always hold converted values.
+//
+//   If the text is writable and outlives the document, strings and keys can be decoded into the text itself:
+//     JsonValue json = json_parse_in_situ(buffer, 0); // buffer is modified
+//
+//   Such strings and objects have JSON_VALUE_BORROWED set in JsonValue.flags, json_free() leaves their text alone.
+//   Adding a field to such an object copies its keys first, json_duplicate() always makes a copy that owns everything.
+//
+//   When parsing many small documents, a JsonParser keeps its memory between them:
+//     JsonParser parser;
+//     json_parser_init(&parser);
+//     for (...) {
+//       JsonValue json = json_parser_parse(&parser, message, 0);
+//       ...
+//       json_parser_reset(&parser); // releases every document parsed since the last reset at once
+//     }
+//     json_parser_free(&parser);
+//
+//   Documents are allocated from arena chunks of JSON_PARSER_CHUNK_SIZE bytes that are reused after a reset.
+//   Keys of up to 64 characters are interned (up to JSON_PARSER_MAX_KEYS of them) and kept across resets.
+//   Don't json_free() these documents, change them only with json_set_allocator(&parser.allocator)
+//   and use json_duplicate() to keep one past the next reset. src/benchmark.c compares it with json_parse().
+//   json_parser_parse_in_situ() combines both, so a document costs no allocations once the arena is warm.
+//
+//   Input that doesn't fit in memory, or has to be decompressed first, can be streamed through a read callback.
+//   Wrap gzread(), ZSTD_decompressStream() or fread() and every value is handed to a callback as soon as it's complete:
+//     int64_t read_gz(void* user, void* buffer, uint64_t size) { return gzread((gzFile)user, buffer, (unsigned)size); }
+//     json_bool ok;
+//     json_parse_stream(read_gz, gz, JSON_STREAM_ELEMENTS | JSON_STREAM_THREADED, on_record, user_data, &ok);
+//
+//   The input is a sequence of values (e.g. one per line), or with JSON_STREAM_ELEMENTS a single array whose elements
+//   are handed out one by one. Memory stays at about the largest value plus JSON_STREAM_BLOCK_SIZE bytes. Values are
+//   parsed in situ with a JsonParser that's reset after every callback, json_duplicate() the ones you want to keep.
+//   JSON_PARSE_LAZY_NUMBERS is ignored since the text is reused. JSON_STREAM_THREADED calls read() on a second thread
+//   so decompression and parsing overlap, #define JSON_NO_THREADS to leave threads out (and pthreads on POSIX).
+//   json_parse_stream_file() streams a file that isn't compressed.
+//
+//   The stream stops at the first error: read() returning -1, a value that doesn't parse or is cut off by the end
+//   of the input, or an array of JSON_STREAM_ELEMENTS that isn't closed. Values that don't parse never reach the
+//   callback, ok is set to 0 and the count tells how many values came before the error.
+//
+//   Many small files are loaded at once with json_parse_files(), on a pool of threads (0 for one per core):
+//     JsonFileResult* results = ...; // one per path
+//     uint32_t parsed = json_parse_files(paths, count, 0, results, 0); // how many files parsed
+//
+//   Every worker reads a file in one go into a buffer it reuses and parses it right away, results[i].loaded is 0
+//   for files that couldn't be read and results[i].parsed is 0 for files that don't parse. The documents are
+//   allocated with JSON_MALLOC and json_free() as usual, JSON_PARSE_LAZY_NUMBERS is ignored since the text doesn't
+//   outlive the call.
+//
+//   A JsonEditor keeps a document in sync with text that's being edited, without parsing all of it again:
+//     JsonEditor editor;
+//     json_editor_init(&editor, text, 0);
+//     JsonValue* changed = json_editor_replace(&editor, offset, length, JSTR("8080"), 4);
+//     json_editor_free(&editor);
+//
+//   The editor keeps its own copy of the text (editor.text) and the span of every array and object in it.
+//   An edit reparses only the innermost array or object around it and swaps it into editor.root, which is what
+//   json_editor_replace() returns. If that doesn't parse anymore the next one out is tried, up to a full parse.
+//   editor.valid is 0 while the text doesn't parse. Don't change editor.root yourself.
+//
 //  ACCESSING:
 //   To access the various types that the JsonValue can hold, you can access them in various different ways.
-//   There are 6 defined types in the implementation:
+//   There are 8 defined types in the implementation:
 //     JSON_NULL
-//     JSON_STRING -> JsonValue.string_value (json_char*)
-//     JSON_NUMBER -> JsonValue.number_value (double)
-//     JSON_OBJECT -> JsonValue.object_value (JsonObject*)
-//     JSON_ARRAY  -> JsonValue.array_value  (JsonArray*)
-//     JSON_BOOL   -> JsonValue.bool_value   (bool)
+//     JSON_STRING     -> JsonValue.string_value (json_char*)
+//     JSON_NUMBER     -> JsonValue.number_value (double)
+//     JSON_OBJECT     -> JsonValue.object_value (JsonObject*)
+//     JSON_ARRAY      -> JsonValue.array_value  (JsonArray*)
+//     JSON_BOOL       -> JsonValue.bool_value   (bool)
+//     JSON_RAW_NUMBER -> JsonValue.raw_number   (const json_char*), only with JSON_PARSE_LAZY_NUMBERS
+//     JSON_NUMBER_ARRAY -> JsonValue.number_array_value (JsonNumberArray*)
+//
+//   json_get_number() and json_get_int64() read both kinds of numbers.
+//
+//   A JsonNumberArray holds either JsonNumberArray.integers or JsonNumberArray.doubles, depending on is_integer.
+//   They can be processed directly, or one at a time with json_number_array_get().
+//   json_add_element(), json_remove_element(), [] and queries only work on JSON_ARRAY, call json_number_array_expand() first.
 //
 //   You can get the type of the JsonValue by doing JsonValue.type and comparing it with the enum listed above.
 //   Note that all these values are in a union.
@@ -67,7 +159,39 @@
 //
 //     JsonValue& age = json[JSTR("age")];
 //     // OR
-//     JsonValue& age = json_find_field_ref(&json, JSTR("age"));
+//     JsonValue& age = json_get_field_ref(&json, JSTR("age"));
+//
+//   Missing keys return a reference to a per-thread null value, see json::Document below for lookups that can't dangle.
+//
+//  QUERYING:
+//   Paths that are looked up often can be compiled once and evaluated without allocating:
+//     JsonQuery query;
+//     json_query_compile(&query, JSTR("/servers/0/port"));  // JSON Pointer (RFC 6901)
+//     json_query_compile(&query, JSTR("$.servers[*].port")); // JSONPath subset
+//     JsonValue* port = json_query_first(&query, &json);
+//     json_query_each(&query, &json, callback, user_data);
+//     json_query_free(&query);
+//
+//   The JSONPath subset supports .key, ['key'], [index], [-index], [start:end:step] and .*/[*].
+//
+//   If you only need a few parts of a big document, json_parse_filtered() takes compiled queries and only builds
+//   the values that match, everything else is skipped by matching quotes and brackets:
+//     json_parse_filtered(text, &query, 1, callback, user_data);
+//
+//   The value passed to the callback is freed afterwards, use json_share() to keep it.
+//   Negative indices and slices need the length of the array, so those arrays are parsed in full.
+//
+//   Arrays of objects can be parsed straight into columns, without building a JsonObject per row:
+//     JsonColumn columns[2] = {};
+//     columns[0].name = JSTR("ts");   columns[0].type = JSON_COLUMN_INT64;
+//     columns[1].name = JSTR("host"); columns[1].type = JSON_COLUMN_STRING;
+//
+//     json_query_compile(&query, JSTR("$.rows"));
+//     uint32_t rows = json_parse_columns(text, &query, columns, 2);
+//     // columns[0].integers[row], columns[1].blob + columns[1].offsets[row], columns[i].valid[row]
+//     json_columns_free(columns, 2);
+//
+//   Fields that are missing, null or of another type leave valid[row] at 0, other fields are skipped.
 //
 //  CREATING:
 //   Creating new JSON values is quite easy.
@@ -85,6 +209,10 @@
 //
 //      json_add_element(&arr, nested_arr);
 //
+//   Number arrays are created from a buffer and json_add_number() appends to them:
+//      JsonValue samples = json_number_array(values, count);  // or json_int64_array()
+//      json_add_number(&samples, 0.5);
+//
 //   If you want to remove an element, you can use json_remove_element(&arr, index)
 //   Note that it will take care of resizing an array. It only grows.
 //   If you add a heap-allocated JsonValue (array/object/string) to a JsonValue it will assume ownership of the pointer.
@@ -102,12 +230,61 @@
 //   If you were to free 1 and still use the other you'd have a free-after-use error. BEWARE!
 //   Consider using json_duplicate() to make copies of a JsonValue.
 //
+//   If you need many copies of the same tree, json_share() is O(1) for arrays and objects.
+//   Shared arrays/objects are reference counted and copied on write: json_add_field(), json_add_element() and
+//   json_remove_element() first copy the level they modify. To modify something deeper use json_get_field_mut()
+//   and json_get_element_mut(), they only copy the levels along the path:
+//     JsonValue request = json_share(&base_config);
+//     JsonValue* port = json_get_field_mut(json_get_field_mut(&request, JSTR("server")), JSTR("port"));
+//     *port = json_number(8080);
+//     ...
+//     json_free(&request); // base_config is untouched
+//
+//   Writing through pointers from json_get_field() or JsonArray.values bypasses this and changes every copy.
+//   Reference counts are atomic, so copies from json_share() can be freed and made unique on different threads.
+//   A single JsonValue still isn't safe to change from two threads at once.
+//
 //   Adding fields to objects is similar to arrays, you can use json_add_field():
 //      JsonValue obj = json_object();
 //      json_add_field(&obj, JSTR("key"), json_number(10.0));
 //
 //   Note that it will not check if a certain field already exists as per the ECMA-404 standard.
-//   More control over seeing if fields exist/removing fields/etc is still @TODO
+//   json_set_field() replaces the field if it exists and appends it otherwise, in the same walk over the members.
+//   json_append_field() takes the field it returned last time, so building a large object doesn't walk it each time.
+//   json_remove_field() stops at the first match. json_splice_elements() removes and inserts any number of
+//   elements while moving the rest of the array only once:
+//      json_set_field(&obj, JSTR("key"), json_number(11.0));
+//      json_splice_elements(&arr, 1, 3, values, 2); // replaces elements 1, 2 and 3 with values[0] and values[1]
+//
+//  PATCHING:
+//   JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7386) documents are applied in place, only the levels
+//   along each path are touched:
+//      json_bool ok = json_apply_patch(&config, &patch);
+//      json_apply_merge_patch(&config, &merge);
+//
+//   json_apply_patch() stops at the first operation that fails and returns 0, the operations before it stay applied.
+//   For all or nothing patch a json_share() of the document and only swap it in on success.
+//   json_equals() is the comparison used by "test", numbers are compared by value and object members in any order.
+//
+//   json_diff() returns the patch that turns one tree into another, json_diff_each() streams the operations instead:
+//      JsonValue patch = json_diff(&previous, &current);
+//      json_diff_each(&previous, &current, callback, user_data); // value is only valid during the callback
+//
+//   Subtrees are compared by a 64-bit structural hash that is computed once per array/object, a match is confirmed
+//   with json_equals() so a collision can't drop a change, and shared ones (json_share()) aren't even hashed. Object members are matched by key,
+//   arrays by the longest common subsequence of their element hashes after skipping the common prefix and suffix.
+//   If that middle part is too big for an LCS table, its elements are compared by position.
+//
+//   The same hash is available on its own, trees that are json_equals() hash equal without being stringified:
+//      uint64_t h = json_hash(&json, NULL);
+//      JsonHashCache cache = {};
+//      json_hash(&a, &cache); json_hash(&b, &cache); // arrays/objects are hashed once across calls
+//      json_hash_cache_free(&cache);
+//
+//   The cache is keyed by storage, so only keep it while the trees don't change. Entries are forgotten whenever an
+//   array or object is freed (json_free(), json_parser_reset(), json_compact_free()), as its address could be
+//   reused by another one.
+//   Hashes are stable for a given json_char type, but not between the wide and JSON_USE_SINGLE_BYTE builds.
 //
 //  EXPORTING:
 //
@@ -120,11 +297,88 @@
 //     JsonValue json = ...;
 //     json_bool minified = 1;
 //     json_char* out = alloc(size);
-//     json_stringify(&json, out, size, indent_level, minified);
+//     json_stringify(&json, out, size, JSON_INDENT_STEP, minified);
+//
+//   json_stringify() returns 0 if the output didn't fit and was truncated.
+//   If you don't know the size up front, json_stringify_alloc() returns a heap-allocated string that you JSON_FREE() yourself.
+//
+//   json_stringify_canonical() writes the JSON Canonicalization Scheme (RFC 8785) form, for signing or content addressing:
+//   no whitespace, members sorted by key, numbers in their shortest round-trip form and only the required escapes.
+//      json_char* canonical = json_stringify_canonical(&json, &length); // JSON_FREE() it
+//   It returns NULL for trees holding NaN or infinity, which have no canonical form.
+//
+//   Strings and keys are escaped as per RFC 8259. Runs of characters that don't need escaping are found
+//   16/32 bytes at a time with SSE2/AVX2 if the compiler has them enabled, and copied in bulk.
 //
 //   Customize your export:
 //     #define JSON_INDENT_CHAR to change the character used for indenting. Space ' ' by default.
 //     #define JSON_INDENT_STEP by how many characters it will indent. 2 by default.
+//     #define JSON_ESCAPE_UNICODE to write every non-ASCII character as a \u escape.
+//
+//  BINARY:
+//
+//   JsonValues can be encoded to and decoded from CBOR (RFC 8949) to avoid text formatting between services:
+//     JsonCborWriter writer;
+//     json_cbor_writer_init(&writer, NULL, NULL);
+//     json_cbor_encode(&json, &writer);
+//     // writer.data/writer.size now hold the encoded bytes
+//     JsonValue copy = json_cbor_decode(writer.data, writer.size);
+//     json_cbor_writer_free(&writer);
+//
+//   Pass a flush callback to json_cbor_writer_init() to stream the output in JSON_CBOR_FLUSH_SIZE chunks.
+//   Set writer.sized_containers to wrap arrays/objects in a byte string (tag 24), json_cbor_skip() can then skip them in O(1).
+//   JsonCborReader and json_cbor_read() let you walk the encoded items without building a JsonValue.
+//   json_cbor_decode() and json_cbor_skip() give up on containers nested deeper than JSON_CBOR_MAX_DEPTH.
+//
+//  SNAPSHOTS:
+//
+//   A parsed document can be written to a position independent snapshot, which can later be memory mapped
+//   and read directly without parsing or allocating anything:
+//     json_snapshot_write(&json, "config.snap");
+//
+//     JsonSnapshot snap;
+//     json_snapshot_map(&snap, "config.snap");
+//     const JsonSnapshotNode* port = json_snapshot_get_field(&snap, json_snapshot_root(&snap), JSTR("port"));
+//     double value = json_snapshot_number(port);
+//     json_snapshot_unmap(&snap);
+//
+//   Snapshots use native endianness and json_char size, json_snapshot_open() rejects ones that don't match.
+//   Only the header is validated, so only map snapshots you created yourself.
+//
+//  STATISTICS:
+//
+//   #define JSON_ENABLE_STATS to record where parsing time and memory go, it's compiled out otherwise:
+//     JsonStats stats = {};
+//     JsonStats* previous = json_set_stats(&stats);
+//     JsonValue json = json_parse(some_text);
+//     json_set_stats(previous);
+//     // stats.bytes_scanned, stats.values[JSON_STRING], stats.allocations, stats.max_depth, stats.number_time, ...
+//
+//   Every call on the thread adds to the stats that are set, zero them again to measure a single call.
+//   Use json_stats_merge() to add up the stats of several threads.
+//   Times come from a monotonic clock read around every number and string, so expect the parser to be slower while recording.
+//
+//  MEMORY USAGE:
+//
+//   json_memory_usage() adds up what a tree occupies, it works without JSON_ENABLE_STATS:
+//     JsonMemoryUsage usage = {};
+//     json_memory_usage(&json, &usage);
+//     // usage.bytes, usage.slack_bytes, usage.allocations, usage.values[JSON_STRING], usage.members
+//
+//   Call it on every cached tree with the same JsonMemoryUsage to get a total. Shared parts are counted
+//   once for every tree they're in, borrowed strings and raw numbers count nothing as they belong to the text.
+//
+//   json_compact() copies a tree into a single allocation, without spare array capacity or a malloc per node:
+//     JsonCompactTree tree;
+//     json_compact(&tree, &json);
+//     json_free(&json);
+//     // read tree.root, change it only with json_set_allocator(&tree.allocator)
+//     json_compact_free(&tree);
+//
+//   The tree can't be moved once compacted, raw numbers are converted so it doesn't depend on the parsed text.
+//   Changes that don't fit in the block are allocated with the allocator that was set during json_compact(),
+//   pieces they replace stay in the block until it's freed. Compact again to reclaim them. json_compact_free() only
+//   walks the tree if anything was allocated outside.
 //
 //  SETTINGS:
 //
@@ -150,6 +404,7 @@ extern "C" {
 #include <stdarg.h>
 #include <assert.h>
 #include <wchar.h>
+#include <limits.h>
 #include <malloc.h>
   
   // @TODO: cleanup
@@ -160,6 +415,9 @@ extern "C" {
 #  define json_strcpy wcscpy
 #  define json_strlen wcslen
 #  define json_strncpy wcsncpy
+#  define json_strncmp wcsncmp
+#  define json_strtod wcstod
+#  define json_strtoll wcstoll
 #  define json_char wchar_t
 #  define json_fgets fgetws
 #  define json_sprintf(out, len, str, ...) swprintf(out, len, str, ##__VA_ARGS__)
@@ -176,9 +434,12 @@ extern "C" {
 #  define json_strcpy strcpy
 #  define json_strlen strlen
 #  define json_strncpy strncpy
+#  define json_strncmp strncmp
+#  define json_strtod strtod
+#  define json_strtoll strtoll
 #  define json_char char
 #  define json_fgets fgets
-#  define json_sprintf(out, len, str) sprintf(out, str)
+#  define json_sprintf(out, len, str, ...) snprintf(out, len, str, ##__VA_ARGS__)
 #  define JSON_CHAR_MAX CHAR_MAX
 #  define JSON_READ_MODE "r"
 #  define JSON_WRITE_MODE "w"
@@ -200,46 +461,95 @@ extern "C" {
     JSON_NUMBER,
     JSON_OBJECT,
     JSON_ARRAY,
-    JSON_BOOL
+    JSON_BOOL,
+    JSON_RAW_NUMBER,
+    JSON_NUMBER_ARRAY
   } JsonType;
   
+  // Flags for json_parse_ex()
+  typedef enum {
+    // Keep numbers as a view of their literal in the source text, see JSON_RAW_NUMBER
+    JSON_PARSE_LAZY_NUMBERS = 1 << 0,
+    
+    // Store arrays that only hold numbers as a JSON_NUMBER_ARRAY
+    JSON_PARSE_NUMBER_ARRAYS = 1 << 1
+  } JsonParseFlags;
+  
+  // Flags of a JsonValue
+  typedef enum {
+    // The string, or the keys of an object, point into the text given to json_parse_in_situ() and aren't freed
+    JSON_VALUE_BORROWED = 1 << 0
+  } JsonValueFlags;
+  
   // Datatypes
   typedef struct {
     struct _JsonValue* values;
     uint32_t count;
     uint32_t capacity;
+    
+    // Number of extra owners through json_share(), 0 if unique
+    uint32_t refs;
   } JsonArray;
   
+  // Contiguous storage for arrays that only hold numbers
+  typedef struct {
+    union {
+      double* doubles;
+      int64_t* integers;
+    };
+    uint32_t count;
+    uint32_t capacity;
+    
+    // Set while every element is an integer literal that fits in an int64_t
+    json_bool is_integer;
+    
+    // Number of extra owners through json_share(), 0 if unique
+    uint32_t refs;
+  } JsonNumberArray;
+  
   typedef struct _JsonObject {
     json_char* key;
     struct _JsonValue* value;
     
     struct _JsonObject* next;
+    
+    // Number of extra owners of the whole list through json_share(), only used on the first node
+    uint32_t refs;
+    
+    // Cached hash of the key to speed up lookups
+    uint32_t key_hash;
   } JsonObject;
   
   typedef struct _JsonValue {
     JsonType type;
+    uint32_t flags;
     
     union {
       json_char* string_value;
       double number_value;
       JsonObject* object_value;
       JsonArray* array_value;
+      JsonNumberArray* number_array_value;
       json_bool bool_value;
+      
+      // Points into the parsed text, the literal ends at the first character that can't be part of a number
+      const json_char* raw_number;
     };
     
 #ifdef __cplusplus
+    // Missing keys return a per-thread null value, it is reset on every miss so don't write to it
     _JsonValue& operator[](const json_char* key) {
-      for (JsonObject* v = object_value; v != NULL; v = v->next) {
-        if (json_strcmp(key, v->key) == 0) {
-          return *v->value;
-          break;
+      if (type == JSON_OBJECT) {
+        for (JsonObject* v = object_value; v != NULL; v = v->next) {
+          if (v->key && json_strcmp(key, v->key) == 0) {
+            return *v->value;
+          }
         }
       }
       
-      JsonValue dummy;
-      dummy.type = JSON_NULL;
-      return dummy;
+      static thread_local _JsonValue missing;
+      missing = _JsonValue();
+      return missing;
     }
     
     _JsonValue& operator[](int index) {
@@ -253,16 +563,215 @@ extern "C" {
   // API
   JsonValue json_parse_from_file(const char* path);
   JsonValue json_parse(const json_char* json_text);
+  JsonValue json_parse_ex(const json_char* json_text, uint32_t flags);
+  JsonValue json_parse_in_situ(json_char* json_text, uint32_t flags);
+  
+  // Allocator for JsonValue trees, used instead of JSON_MALLOC/JSON_REALLOC/JSON_FREE while it's set
+  typedef struct {
+    void* (*allocate)(void* user, size_t size);
+    void* (*reallocate)(void* user, void* ptr, size_t size);
+    void (*deallocate)(void* user, void* ptr);
+    void* user;
+  } JsonAllocator;
+  
+  const JsonAllocator* json_set_allocator(const JsonAllocator* allocator);
+  const JsonAllocator* json_get_allocator();
+  
+  JsonValue json_parse_with(const json_char* json_text, uint32_t flags, const JsonAllocator* allocator);
+  JsonValue json_duplicate_with(JsonValue* json, const JsonAllocator* allocator);
+  void json_free_with(JsonValue* json, const JsonAllocator* allocator);
+  
+  // Long-lived parser for many small documents, see json_parser_init()
+  typedef struct _JsonArenaChunk {
+    struct _JsonArenaChunk* next;
+    uint64_t size;
+    uint64_t used;
+  } JsonArenaChunk;
+  
+  typedef struct {
+    json_char* key;
+    uint32_t hash;
+    uint32_t length;
+  } JsonInternedKey;
+  
+  typedef struct {
+    // Arena the documents are allocated from, chunks are kept on reset
+    JsonAllocator allocator;
+    JsonArenaChunk* chunks;
+    JsonArenaChunk* current;
+    
+    // Offset of the last allocation in the current chunk, it can grow or be given back in place
+    uint64_t last;
+    
+    // Open addressing table of keys seen before, kept on reset
+    JsonInternedKey* keys;
+    uint32_t key_count;
+    uint32_t key_capacity;
+  } JsonParser;
+  
+  void json_parser_init(JsonParser* parser);
+  void json_parser_free(JsonParser* parser);
+  void json_parser_reset(JsonParser* parser);
+  JsonValue json_parser_parse(JsonParser* parser, const json_char* json_text, uint32_t flags);
+  JsonValue json_parser_parse_in_situ(JsonParser* parser, json_char* json_text, uint32_t flags);
+  
+  // Flags for json_parse_stream(), combined with JsonParseFlags
+  typedef enum {
+    // The input is one big array, hand out its elements one at a time instead
+    JSON_STREAM_ELEMENTS = 1 << 16,
+    
+    // Call read() on a separate thread, so reading or decompressing overlaps with parsing
+    JSON_STREAM_THREADED = 1 << 17
+  } JsonStreamFlags;
+  
+  // Fills buffer with up to size bytes of UTF-8, returns how many, 0 at the end of the input or -1 on failure
+  typedef int64_t (*JsonReadCallback)(void* user, void* buffer, uint64_t size);
+  
+  // Called for every value in the stream, the value is only valid during the call. Return 0 to stop
+  typedef json_bool (*JsonStreamCallback)(void* user, JsonValue* value);
+  
+  // Returns how many values were handed to callback, ok (optional) is 0 if the stream stopped on an error
+  uint64_t json_parse_stream(JsonReadCallback read, void* read_user, uint32_t flags, JsonStreamCallback callback, void* user, json_bool* ok);
+  uint64_t json_parse_stream_file(const char* path, uint32_t flags, JsonStreamCallback callback, void* user, json_bool* ok);
+  
+  // Result of json_parse_files() for one path
+  typedef struct {
+    JsonValue value;
+    
+    // 0 if the file couldn't be read
+    json_bool loaded;
+    
+    // 0 if the file was read but doesn't parse, value is whatever json_parse() returned and still has to be freed
+    json_bool parsed;
+  } JsonFileResult;
+  
+  uint32_t json_parse_files(const char* const* paths, uint32_t count, uint32_t flags, JsonFileResult* results, uint32_t threads);
+  
+#define JSON_SPAN_NONE 0xFFFFFFFFu
+  
+  // Where an array or object is in the text of a JsonEditor, in the order they open
+  typedef struct {
+    // Offsets of the opening bracket and one past the closing one
+    uint64_t start;
+    uint64_t end;
+    
+    // Enclosing span, JSON_SPAN_NONE for the root, and the element or member position in it
+    uint32_t parent;
+    uint32_t index;
+  } JsonSpan;
+  
+  typedef struct {
+    JsonSpan* data;
+    uint32_t count;
+    uint32_t capacity;
+  } JsonSpans;
+  
+  // A document that's kept in sync with its text as the text is edited
+  typedef struct {
+    JsonValue root;
+    
+    json_char* text;
+    uint64_t length;
+    uint64_t capacity;
+    
+    JsonSpans spans;
+    uint32_t flags;
+    
+    // 0 while the text doesn't parse, every edit reparses all of it until it does again
+    json_bool valid;
+  } JsonEditor;
+  
+  json_bool json_editor_init(JsonEditor* editor, const json_char* text, uint32_t flags);
+  void json_editor_free(JsonEditor* editor);
+  JsonValue* json_editor_replace(JsonEditor* editor, uint64_t offset, uint64_t length, const json_char* text, uint64_t text_length);
+  
+  // Added to by json_memory_usage(), sizes don't include the allocator's own overhead per allocation
+  typedef struct {
+    // Bytes the tree has allocated and how many of them are unused array capacity
+    uint64_t bytes;
+    uint64_t slack_bytes;
+    uint64_t allocations;
+    
+    // Values by JsonType, the elements of a JSON_NUMBER_ARRAY aren't counted on their own
+    uint64_t values[JSON_NUMBER_ARRAY + 1];
+    uint64_t members;
+  } JsonMemoryUsage;
+  
+  void json_memory_usage(JsonValue* json, JsonMemoryUsage* usage);
+  
+  // A copy of a tree in a single block without spare capacity, see json_compact()
+  typedef struct {
+    JsonValue root;
+    
+    // The tree has to be changed with this allocator, pieces that don't fit in the block come from parent
+    JsonAllocator allocator;
+    const JsonAllocator* parent;
+    
+    void* block;
+    uint64_t size;
+    uint64_t used;
+    
+    // Live allocations outside of the block
+    uint64_t outside;
+  } JsonCompactTree;
+  
+  json_bool json_compact(JsonCompactTree* tree, JsonValue* json);
+  void json_compact_free(JsonCompactTree* tree);
+  
+#ifdef JSON_ENABLE_STATS
+  // Counters added to while set with json_set_stats(), times are in nanoseconds
+  typedef struct {
+    uint64_t documents;
+    uint64_t bytes_scanned;
+    
+    // Parsed values by JsonType, elements of a JSON_NUMBER_ARRAY count as JSON_NUMBER
+    uint64_t values[JSON_NUMBER_ARRAY + 1];
+    uint64_t keys;
+    
+    // Deepest nesting of values, 1 for a document that is a single scalar
+    uint32_t max_depth;
+    
+    // Calls made to the allocator, including by json_duplicate(), json_free() and the json_add_*() functions
+    uint64_t allocations;
+    uint64_t reallocations;
+    uint64_t frees;
+    uint64_t bytes_allocated;
+    
+    uint64_t number_time;
+    uint64_t string_time;
+    uint64_t structural_time;
+    
+    // Output of json_stringify(), json_stringify_alloc() and json_export()
+    uint64_t bytes_written;
+  } JsonStats;
+  
+  JsonStats* json_set_stats(JsonStats* stats);
+  void json_stats_merge(JsonStats* into, const JsonStats* from);
+#endif
   
   json_bool json_export(JsonValue* json, const char* path, json_bool minified);
+  json_bool json_stringify(JsonValue* value, json_char* out, int out_size, int indent_level, json_bool minified);
+  json_char* json_stringify_alloc(JsonValue* value, json_bool minified, uint64_t* length);
+  json_char* json_stringify_canonical(JsonValue* value, uint64_t* length);
   
   JsonValue* json_get_field(JsonValue* json, const json_char* key);
+#ifdef __cplusplus
+  JsonValue& json_get_field_ref(JsonValue* json, const json_char* key);
+#endif
+  
+  double json_get_number(JsonValue* json);
+  int64_t json_get_int64(JsonValue* json);
   
   int json_field_count(JsonValue* json, const json_char* key);
   
   void json_free(JsonValue* json);
   JsonValue json_duplicate(JsonValue* json);
   
+  JsonValue json_share(JsonValue* json);
+  void json_make_unique(JsonValue* json);
+  JsonValue* json_get_field_mut(JsonValue* json, const json_char* key);
+  JsonValue* json_get_element_mut(JsonValue* json, uint32_t index);
+  
   inline JsonValue json_null();
   inline JsonValue json_number(double value);
   inline JsonValue json_string(const json_char* value);
@@ -270,13 +779,243 @@ extern "C" {
   
   inline JsonValue json_object();
   inline void json_add_field(JsonValue* json, const json_char* key, JsonValue value);
+  // Appends after last, the field it returned the previous time, so building an object doesn't walk it each time
+  JsonObject* json_append_field(JsonValue* json, JsonObject* last, const json_char* key, JsonValue value);
   
   inline JsonValue json_array();
   inline void json_add_element(JsonValue* json, JsonValue value);
   inline void json_remove_element(JsonValue* json, uint32_t index);
   
+  // Replace-or-append and removal in a single walk of the members, splicing moves the tail of an array once
+  JsonValue* json_set_field(JsonValue* json, const json_char* key, JsonValue value);
+  json_bool json_remove_field(JsonValue* json, const json_char* key);
+  void json_splice_elements(JsonValue* json, uint32_t index, uint32_t remove_count, const JsonValue* values, uint32_t insert_count);
+  
   inline JsonValue json_boolean(json_bool value);
   
+  JsonValue json_number_array(const double* values, uint32_t count);
+  JsonValue json_int64_array(const int64_t* values, uint32_t count);
+  void json_add_number(JsonValue* json, double value);
+  double json_number_array_get(JsonValue* json, uint32_t index);
+  void json_number_array_expand(JsonValue* json);
+  
+  // JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7386), applied in place
+  json_bool json_equals(JsonValue* a, JsonValue* b);
+  json_bool json_apply_patch(JsonValue* json, JsonValue* patch);
+  void json_apply_merge_patch(JsonValue* json, JsonValue* patch);
+  
+  // Differences between two trees as JSON Patch operations
+  typedef enum {
+    JSON_DIFF_ADD,
+    JSON_DIFF_REMOVE,
+    JSON_DIFF_REPLACE
+  } JsonDiffOp;
+  
+  // value is NULL for JSON_DIFF_REMOVE, return 0 to stop
+  typedef json_bool (*JsonDiffCallback)(void* user, JsonDiffOp op, const json_char* path, JsonValue* value);
+  
+  uint32_t json_diff_each(JsonValue* from, JsonValue* to, JsonDiffCallback callback, void* user);
+  JsonValue json_diff(JsonValue* from, JsonValue* to);
+  
+  // Hashes of arrays and objects, keyed by their storage so shared subtrees are only hashed once
+  typedef struct {
+    const void* key;
+    uint64_t hash;
+    
+    // Entries from before any storage was released are stale, the address may have been reused
+    uint64_t epoch;
+  } JsonHashEntry;
+  
+  typedef struct {
+    JsonHashEntry* entries;
+    uint32_t count;
+    uint32_t capacity;
+  } JsonHashCache;
+  
+  // Structural hash that is equal for trees that are json_equals(), the cache is optional
+  uint64_t json_hash(JsonValue* json, JsonHashCache* cache);
+  void json_hash_cache_free(JsonHashCache* cache);
+  
+  // CBOR (RFC 8949) binary encoding
+  typedef json_bool (*JsonCborFlush)(void* user, const uint8_t* data, uint64_t size);
+  
+  typedef struct {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+    
+    // Optional, if set the buffered bytes are handed to flush() whenever they exceed JSON_CBOR_FLUSH_SIZE
+    JsonCborFlush flush;
+    void* user;
+    
+    // Wrap arrays/objects written by json_cbor_encode() in a byte string so readers can skip them in O(1)
+    json_bool sized_containers;
+    uint32_t open_sized;
+    
+    json_bool failed;
+  } JsonCborWriter;
+  
+  typedef struct {
+    const uint8_t* data;
+    uint64_t size;
+    uint64_t curr;
+    
+    // Containers json_cbor_decode()/json_cbor_skip() are inside of, see JSON_CBOR_MAX_DEPTH
+    uint32_t depth;
+  } JsonCborReader;
+  
+  typedef struct {
+    JsonType type;
+    
+    // Element/member count for arrays/objects, byte length for strings
+    uint64_t count;
+    
+    // Set for arrays/objects without a count, they end at a break (json_cbor_read_break())
+    json_bool indefinite;
+    
+    double number_value;
+    json_bool bool_value;
+    
+    // UTF-8 bytes, not null-terminated
+    const uint8_t* string_data;
+  } JsonCborItem;
+  
+  void json_cbor_writer_init(JsonCborWriter* writer, JsonCborFlush flush, void* user);
+  json_bool json_cbor_writer_flush(JsonCborWriter* writer);
+  void json_cbor_writer_free(JsonCborWriter* writer);
+  
+  void json_cbor_write_null(JsonCborWriter* writer);
+  void json_cbor_write_bool(JsonCborWriter* writer, json_bool value);
+  void json_cbor_write_number(JsonCborWriter* writer, double value);
+  void json_cbor_write_string(JsonCborWriter* writer, const json_char* value);
+  void json_cbor_write_array(JsonCborWriter* writer, uint64_t count);
+  void json_cbor_write_object(JsonCborWriter* writer, uint64_t count);
+  json_bool json_cbor_encode(JsonValue* json, JsonCborWriter* writer);
+  
+  void json_cbor_reader_init(JsonCborReader* reader, const uint8_t* data, uint64_t size);
+  json_bool json_cbor_read(JsonCborReader* reader, JsonCborItem* item);
+  json_bool json_cbor_read_break(JsonCborReader* reader);
+  json_bool json_cbor_skip(JsonCborReader* reader);
+  JsonValue json_cbor_decode(const uint8_t* data, uint64_t size);
+  
+  // Position independent snapshots that can be mapped into memory and read without parsing
+  typedef struct {
+    uint32_t type;
+    
+    // Element/member count for arrays/objects, length for strings
+    uint32_t count;
+    
+    // Number bits, bool value, or offset from the start of the snapshot to the string/elements/members
+    uint64_t payload;
+  } JsonSnapshotNode;
+  
+  typedef struct {
+    uint64_t key;
+    uint32_t key_length;
+    uint32_t key_hash;
+    JsonSnapshotNode value;
+  } JsonSnapshotMember;
+  
+  typedef struct {
+    const uint8_t* base;
+    uint64_t size;
+    
+    // Set by json_snapshot_map()
+    void* mapping;
+    uint64_t mapping_size;
+  } JsonSnapshot;
+  
+  uint8_t* json_snapshot_build(JsonValue* json, uint64_t* size);
+  json_bool json_snapshot_write(JsonValue* json, const char* path);
+  
+  json_bool json_snapshot_open(JsonSnapshot* snapshot, const void* data, uint64_t size);
+  json_bool json_snapshot_map(JsonSnapshot* snapshot, const char* path);
+  void json_snapshot_unmap(JsonSnapshot* snapshot);
+  
+  const JsonSnapshotNode* json_snapshot_root(const JsonSnapshot* snapshot);
+  const json_char* json_snapshot_string(const JsonSnapshot* snapshot, const JsonSnapshotNode* node);
+  double json_snapshot_number(const JsonSnapshotNode* node);
+  json_bool json_snapshot_bool(const JsonSnapshotNode* node);
+  const JsonSnapshotNode* json_snapshot_element(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index);
+  const json_char* json_snapshot_key(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index);
+  const JsonSnapshotNode* json_snapshot_value(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index);
+  const JsonSnapshotNode* json_snapshot_get_field(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, const json_char* key);
+  
+  // Compiled JSON Pointer (RFC 6901) and JSONPath queries
+  typedef enum {
+    JSON_QUERY_MEMBER,   // JSON Pointer segment, object key or array index
+    JSON_QUERY_KEY,      // .key or ['key']
+    JSON_QUERY_INDEX,    // [1] or [-1]
+    JSON_QUERY_WILDCARD, // .* or [*]
+    JSON_QUERY_SLICE     // [start:end:step]
+  } JsonQueryType;
+  
+  typedef struct {
+    JsonQueryType type;
+    uint32_t key_hash;
+    json_char* key;
+    
+    // Index for JSON_QUERY_INDEX/JSON_QUERY_MEMBER (-1 if the key isn't an index), bounds for JSON_QUERY_SLICE
+    int64_t start;
+    int64_t end;
+    int64_t step;
+    json_bool has_start;
+    json_bool has_end;
+  } JsonQuerySegment;
+  
+  typedef struct {
+    JsonQuerySegment* segments;
+    uint32_t count;
+  } JsonQuery;
+  
+  // Return 0 to stop the iteration
+  typedef json_bool (*JsonQueryCallback)(void* user, JsonValue* value);
+  
+  json_bool json_query_compile(JsonQuery* query, const json_char* path);
+  void json_query_free(JsonQuery* query);
+  JsonValue* json_query_first(const JsonQuery* query, JsonValue* json);
+  uint32_t json_query_each(const JsonQuery* query, JsonValue* json, JsonQueryCallback callback, void* user);
+  
+  // Parses only the parts of the text that match one of the queries, everything else is skipped without building values.
+  // The value passed to the callback is freed after the callback returns, use json_share() to keep it.
+  // Return 0 from the callback to stop parsing.
+  typedef json_bool (*JsonFilterCallback)(void* user, uint32_t query_index, JsonValue* value);
+  
+  uint32_t json_parse_filtered(const json_char* json_text, const JsonQuery* queries, uint32_t query_count,
+                               JsonFilterCallback callback, void* user);
+  
+  // Columnar extraction from arrays of objects
+  typedef enum {
+    JSON_COLUMN_NUMBER, // numbers
+    JSON_COLUMN_INT64,  // integers
+    JSON_COLUMN_BOOL,   // bools
+    JSON_COLUMN_STRING  // offsets + blob
+  } JsonColumnType;
+  
+  typedef struct {
+    // Set these before calling json_parse_columns(), zero the rest
+    const json_char* name;
+    JsonColumnType type;
+    
+    // One entry per row, 0 if the field was missing, null or of another type
+    uint8_t* valid;
+    
+    union {
+      double* numbers;
+      int64_t* integers;
+      uint8_t* bools;
+    };
+    
+    // Row i starts at blob + offsets[i] and is null terminated, offsets has one entry per row plus one
+    uint64_t* offsets;
+    json_char* blob;
+    uint64_t blob_size;
+    uint64_t blob_capacity;
+  } JsonColumn;
+  
+  uint32_t json_parse_columns(const json_char* json_text, const JsonQuery* rows, JsonColumn* columns, uint32_t column_count);
+  void json_columns_free(JsonColumn* columns, uint32_t column_count);
+  
   // Overwritable #defines
 #if defined(JSON_MALLOC) && defined(JSON_REALLOC) && defined(JSON_FREE)
   // Ok
@@ -302,614 +1041,7303 @@ extern "C" {
 #  define JSON_INDENT_STEP 2
 #endif
   
+#ifndef JSON_CBOR_FLUSH_SIZE
+#  define JSON_CBOR_FLUSH_SIZE 4096
+#endif
+  
+#ifndef JSON_CBOR_MAX_DEPTH
+#  define JSON_CBOR_MAX_DEPTH 512
+#endif
+  
+#ifndef JSON_PARSER_CHUNK_SIZE
+#  define JSON_PARSER_CHUNK_SIZE 65536
+#endif
+  
+#ifndef JSON_PARSER_MAX_KEYS
+#  define JSON_PARSER_MAX_KEYS 4096
+#endif
+  
+#ifndef JSON_STREAM_BLOCK_SIZE
+#  define JSON_STREAM_BLOCK_SIZE 65536
+#endif
+  
 #ifdef __cplusplus
 }
 #endif
 
-#endif // JSON_H_
+// C++17 struct binding
+// Declare which members of a struct map to which keys, then decode text directly into it:
+//   struct Point { int x; double y; std::vector<std::wstring> tags; };
+//   JSON_BIND(Point, JSON_FIELD(Point, x), JSON_FIELD(Point, y), JSON_FIELD(Point, tags))
+//
+//   Point p;
+//   json::decode(JSTR("{ \"x\": 1, \"y\": 2.5, \"tags\": [] }"), p);
+//   std::basic_string<json_char> text = json::encode(p);
+//
+// Keys are matched through a perfect hash that is computed at compile time.
+// Unknown keys are skipped, missing keys leave the member untouched.
+//
+// decode() and parse() take text of any character type whatever json_char is: char and char8_t are read as UTF-8,
+// char16_t as UTF-16 and char32_t as UTF-32, wchar_t as whichever of the two matches its size.
+// Strings are transcoded to json_char as they're read, so one binary can take all of them.
+// A second template argument picks the parse options, features that are off cost nothing:
+//   struct strict_options : json::parse_options { static constexpr bool strict = true; };
+//   json::decode<strict_options>(u8"[1, 2]", values);
+#if defined(__cplusplus) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#  define JSON_CPP17
+#endif
 
-// Implementation starts here
-#ifdef JSON_IMPLEMENTATION
-#undef JSON_IMPLEMENTATION
+#ifdef JSON_CPP17
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-  
-#include <ctype.h>
-#include <string.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <stdlib.h>
-#include <math.h>
-#include <inttypes.h>
+
+#define JSON_FIELD(type, member) ::json::make_field(JSTR(#member), &type::member)
+#define JSON_BIND(type, ...) \
+  template <> struct json::binding<type> { \
+    static constexpr auto fields = std::make_tuple(__VA_ARGS__); \
+  };
+
+namespace json {
   
-  typedef struct JsonContext {
-    const json_char* text;
-    uint64_t len;
-    uint64_t curr;
-    
-    json_char buffer[256];
-    
-    json_bool is_parsing;
-  } JsonContext;
+  template <typename T, typename M>
+  struct field_info {
+    const json_char* name;
+    M T::* member;
+  };
   
-  static void* json_alloc(uint32_t size) {
-    void* ptr = (void*)JSON_MALLOC(size);
-    
-#ifndef JSON_MEM_ALREADY_ZEROED
-    memset(ptr, 0, size);
-#endif
-    
-    return ptr;
+  template <typename T, typename M>
+  constexpr field_info<T, M> make_field(const json_char* name, M T::* member) {
+    return field_info<T, M>{ name, member };
   }
   
-  inline JsonValue json_null() {
-    JsonValue json = {};
-    json.type = JSON_NULL;
-    
+  // Defaults follow the C parser's build settings
+  struct parse_options {
+#ifdef JSON_ALLOW_COMMENTS
+    static constexpr bool comments = true;
+#else
+    static constexpr bool comments = false;
+#endif
+#ifdef JSON_ALLOW_EXP_DECIMALS
+    static constexpr bool exp_decimals = true;
+#else
+    static constexpr bool exp_decimals = false;
+#endif
+    // Reject control characters in strings, leading zeros and lone surrogates
+    static constexpr bool strict = false;
+  };
+  
+  // Specialised through JSON_BIND
+  template <typename T>
+  struct binding;
+  
+  template <typename T, typename = void>
+  struct is_bound : std::false_type {};
+  
+  template <typename T>
+  struct is_bound<T, std::void_t<decltype(binding<T>::fields)>> : std::true_type {};
+  
+  namespace detail {
+    
+    template <typename CharT>
+    constexpr size_t length(const CharT* str) {
+      size_t len = 0;
+      while (str[len]) ++len;
+      return len;
+    }
+    
+    constexpr uint32_t hash(const json_char* str, size_t len, uint32_t seed) {
+      uint32_t h = 2166136261u ^ seed;
+      for (size_t i = 0; i < len; ++i) {
+        h = (h ^ (uint32_t)str[i]) * 16777619u;
+      }
+      return h ^ (h >> 15);
+    }
+    
+    constexpr size_t table_size(size_t count) {
+      size_t size = 1;
+      while (size < count * 2) size *= 2;
+      return size;
+    }
+    
+    template <size_t N>
+    struct perfect_hash {
+      static constexpr size_t SIZE = table_size(N);
+      
+      uint32_t seed;
+      std::array<int32_t, SIZE> slots;
+      
+      constexpr int32_t find(const json_char* str, size_t len) const {
+        return slots[hash(str, len, seed) & (SIZE - 1)];
+      }
+    };
+    
+    template <size_t N>
+    constexpr perfect_hash<N> make_perfect_hash(const std::array<const json_char*, N>& names) {
+      perfect_hash<N> ph = {};
+      
+      for (uint32_t seed = 0;; ++seed) {
+        ph.seed = seed;
+        for (size_t i = 0; i < ph.SIZE; ++i) ph.slots[i] = -1;
+        
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; ++i) {
+          size_t slot = hash(names[i], length(names[i]), seed) & (ph.SIZE - 1);
+          if (ph.slots[slot] != -1) collision = true;
+          else ph.slots[slot] = (int32_t)i;
+        }
+        
+        if (!collision) return ph;
+      }
+    }
+    
+    template <typename Tuple, size_t... I>
+    constexpr std::array<const json_char*, sizeof...(I)> field_names(const Tuple& fields, std::index_sequence<I...>) {
+      return {{ std::get<I>(fields).name... }};
+    }
+    
+    template <typename T>
+    struct bound_fields {
+      static constexpr auto& fields = binding<T>::fields;
+      static constexpr size_t COUNT = std::tuple_size<std::decay_t<decltype(binding<T>::fields)>>::value;
+      static constexpr std::array<const json_char*, COUNT> names = field_names(fields, std::make_index_sequence<COUNT>());
+      static constexpr perfect_hash<COUNT> table = make_perfect_hash<COUNT>(names);
+    };
+    
+    template <typename T> struct is_vector : std::false_type {};
+    template <typename T, typename A> struct is_vector<std::vector<T, A>> : std::true_type {};
+    
+    template <typename T> struct is_optional : std::false_type {};
+    template <typename T> struct is_optional<std::optional<T>> : std::true_type {};
+    
+    // Input of any character type is read as UTF-8, UTF-16 or UTF-32 depending on its size
+    template <typename CharT>
+    inline uint32_t unit(CharT c) {
+      return (uint32_t)(typename std::make_unsigned<CharT>::type)c;
+    }
+    
+    // Invalid UTF-8 and lone surrogates are passed through as-is, like the C parser does
+    template <typename CharT>
+    inline uint32_t next_codepoint(const CharT*& p, const CharT* end) {
+      uint32_t c = unit(*p++);
+      
+      if constexpr (sizeof(CharT) == 1) {
+        uint32_t extra;
+        if (c < 0x80) return c;
+        else if ((c & 0xE0) == 0xC0) { extra = 1; c &= 0x1F; }
+        else if ((c & 0xF0) == 0xE0) { extra = 2; c &= 0x0F; }
+        else if ((c & 0xF8) == 0xF0) { extra = 3; c &= 0x07; }
+        else return c;
+        
+        if (end - p < (ptrdiff_t)extra) return unit(p[-1]);
+        for (uint32_t i = 0; i < extra; ++i) c = (c << 6) | (unit(*p++) & 0x3F);
+      } else if constexpr (sizeof(CharT) == 2) {
+        if (c >= 0xD800 && c <= 0xDBFF && p < end && unit(*p) >= 0xDC00 && unit(*p) <= 0xDFFF) {
+          c = 0x10000 + ((c - 0xD800) << 10) + (unit(*p++) - 0xDC00);
+        }
+      }
+      
+      return c;
+    }
+    
+    inline void append_codepoint(std::basic_string<json_char>& out, uint32_t cp) {
+      if constexpr (sizeof(json_char) == 1) {
+        if (cp < 0x80) {
+          out += (json_char)cp;
+        } else if (cp < 0x800) {
+          out += (json_char)(0xC0 | (cp >> 6));
+          out += (json_char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+          out += (json_char)(0xE0 | (cp >> 12));
+          out += (json_char)(0x80 | ((cp >> 6) & 0x3F));
+          out += (json_char)(0x80 | (cp & 0x3F));
+        } else {
+          out += (json_char)(0xF0 | (cp >> 18));
+          out += (json_char)(0x80 | ((cp >> 12) & 0x3F));
+          out += (json_char)(0x80 | ((cp >> 6) & 0x3F));
+          out += (json_char)(0x80 | (cp & 0x3F));
+        }
+      } else if constexpr (sizeof(json_char) == 2) {
+        if (cp > 0xFFFF) {
+          cp -= 0x10000;
+          out += (json_char)(0xD800 + (cp >> 10));
+          out += (json_char)(0xDC00 + (cp & 0x3FF));
+        } else {
+          out += (json_char)cp;
+        }
+      } else {
+        out += (json_char)cp;
+      }
+    }
+    
+    // Copies a run of text into json_char, converting only if the encodings differ
+    template <typename CharT>
+    inline void append_text(std::basic_string<json_char>& out, const CharT* begin, const CharT* end) {
+      if constexpr (sizeof(CharT) == sizeof(json_char)) {
+        out.reserve(out.size() + (size_t)(end - begin));
+        for (; begin < end; ++begin) out += (json_char)*begin;
+      } else {
+        while (begin < end) append_codepoint(out, next_codepoint(begin, end));
+      }
+    }
+    
+    template <typename CharT, typename Options>
+    struct reader {
+      const CharT* curr;
+      const CharT* end;
+      std::basic_string<json_char> scratch;
+      
+      void skip_whitespace() {
+        while (curr < end) {
+          if (*curr == ' ' || *curr == '\t' || *curr == '\n' || *curr == '\r') {
+            ++curr;
+          } else if constexpr (Options::comments) {
+            if (*curr != '#') return;
+            while (curr < end && *curr != '\n') ++curr;
+          } else {
+            return;
+          }
+        }
+      }
+      
+      bool consume(char c) {
+        skip_whitespace();
+        if (curr < end && *curr == (CharT)c) {
+          ++curr;
+          return true;
+        }
+        return false;
+      }
+      
+      uint32_t peek() {
+        skip_whitespace();
+        return (curr < end) ? unit(*curr) : 0;
+      }
+      
+      bool consume_word(const char* word) {
+        skip_whitespace();
+        const CharT* p = curr;
+        for (; *word; ++word, ++p) {
+          if (p >= end || *p != (CharT)*word) return false;
+        }
+        curr = p;
+        return true;
+      }
+      
+      static int hex_digit(uint32_t c) {
+        if (c >= '0' && c <= '9') return (int)(c - '0');
+        if (c >= 'a' && c <= 'f') return (int)(c - 'a') + 10;
+        if (c >= 'A' && c <= 'F') return (int)(c - 'A') + 10;
+        return -1;
+      }
+      
+      bool read_hex(uint32_t& cp) {
+        if (end - curr < 4) return false;
+        
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+          int digit = hex_digit(unit(curr[i]));
+          if (digit < 0) return false;
+          cp = (cp << 4) | (uint32_t)digit;
+        }
+        curr += 4;
+        return true;
+      }
+      
+      // Appends the unescaped string to out, curr must be on the opening quote
+      bool read_string(std::basic_string<json_char>& out) {
+        if (!consume('"')) return false;
+        
+        for (;;) {
+          const CharT* run = curr;
+          while (curr < end && *curr != '"' && *curr != '\\') {
+            if constexpr (Options::strict) {
+              if (unit(*curr) < 0x20) return false;
+            }
+            ++curr;
+          }
+          append_text(out, run, curr);
+          
+          if (curr >= end) return false;
+          if (*curr++ == '"') return true;
+          if (curr >= end) return false;
+          
+          switch (unit(*curr++)) {
+            case '"':  out += JSTR('"'); break;
+            case '\\': out += JSTR('\\'); break;
+            case '/':  out += JSTR('/'); break;
+            case 'b':  out += JSTR('\b'); break;
+            case 'f':  out += JSTR('\f'); break;
+            case 'n':  out += JSTR('\n'); break;
+            case 'r':  out += JSTR('\r'); break;
+            case 't':  out += JSTR('\t'); break;
+            case 'u': {
+              uint32_t cp;
+              if (!read_hex(cp)) return false;
+              
+              // Surrogate pairs are joined, so they come out right in any encoding
+              if (cp >= 0xD800 && cp <= 0xDBFF && end - curr >= 6 && curr[0] == '\\' && curr[1] == 'u') {
+                const CharT* pair = curr;
+                uint32_t low;
+                curr += 2;
+                if (read_hex(low) && low >= 0xDC00 && low <= 0xDFFF) cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                else curr = pair;
+              }
+              
+              if constexpr (Options::strict) {
+                if (cp >= 0xD800 && cp <= 0xDFFF) return false;
+              }
+              
+              append_codepoint(out, cp);
+              break;
+            }
+            
+            default: return false;
+          }
+        }
+      }
+      
+      // Keys without escapes are returned in place when the input is json_char, others are unescaped into scratch
+      bool read_key(const json_char*& key, size_t& len) {
+        skip_whitespace();
+        if (curr >= end || *curr != '"') return false;
+        
+        if constexpr (std::is_same<CharT, json_char>::value) {
+          const json_char* start = curr + 1;
+          const json_char* p = start;
+          while (p < end && *p != '"' && *p != '\\') ++p;
+          
+          if (p < end && *p == '"') {
+            key = start;
+            len = (size_t)(p - start);
+            curr = p + 1;
+            return true;
+          }
+        }
+        
+        scratch.clear();
+        if (!read_string(scratch)) return false;
+        
+        key = scratch.data();
+        len = scratch.size();
+        return true;
+      }
+      
+      static bool is_digit(const CharT* p, const CharT* end) {
+        return p < end && *p >= '0' && *p <= '9';
+      }
+      
+      // Validates a number according to the JSON grammar and returns its length
+      size_t scan_number(bool& is_integer) {
+        skip_whitespace();
+        const CharT* p = curr;
+        
+        if (p < end && *p == '-') ++p;
+        const CharT* digits = p;
+        while (is_digit(p, end)) ++p;
+        if (p == digits) return 0;
+        
+        if constexpr (Options::strict) {
+          if (*digits == '0' && p - digits > 1) return 0;
+        }
+        
+        is_integer = true;
+        if (p < end && *p == '.') {
+          is_integer = false;
+          const CharT* frac = ++p;
+          while (is_digit(p, end)) ++p;
+          if (p == frac) return 0;
+        }
+        
+        if (p < end && (*p == 'e' || *p == 'E')) {
+          is_integer = false;
+          ++p;
+          if (p < end && (*p == '+' || *p == '-')) ++p;
+          const CharT* exp = p;
+          while (is_digit(p, end)) ++p;
+          if (p == exp) return 0;
+          
+          if constexpr (Options::exp_decimals) {
+            if (p < end && *p == '.' && is_digit(p + 1, end)) {
+              ++p;
+              while (is_digit(p, end)) ++p;
+            }
+          }
+        }
+        
+        return (size_t)(p - curr);
+      }
+      
+      template <typename I>
+      bool read_integer(I& out) {
+        bool is_integer;
+        size_t len = scan_number(is_integer);
+        if (len == 0) return false;
+        
+        if (!is_integer) {
+          // Accept values like 1.0 or 1e3 as long as they're whole
+          double d;
+          if (!read_double(d)) return false;
+          
+          // Casting a value outside of I is undefined, min() and max() + 1 are powers of two so the bounds are exact
+          if (!(d >= (double)std::numeric_limits<I>::min() && d < (double)std::numeric_limits<I>::max() + 1.0)) return false;
+          if (d != (double)(I)d) return false;
+          out = (I)d;
+          return true;
+        }
+        
+        const CharT* p = curr;
+        bool negative = (*p == '-');
+        if (negative) {
+          if (!std::is_signed<I>::value) return false;
+          ++p;
+        }
+        
+        // Accumulate negatively so the minimum value fits
+        typedef std::make_unsigned_t<I> U;
+        U limit = negative ? (U)std::numeric_limits<I>::max() + 1 : (U)std::numeric_limits<I>::max();
+        U value = 0;
+        for (; p < curr + len; ++p) {
+          U digit = (U)(unit(*p) - '0');
+          if (value > (limit - digit) / 10) return false;
+          value = value * 10 + digit;
+        }
+        
+        out = negative ? (I)(0 - value) : (I)value;
+        curr += len;
+        return true;
+      }
+      
+      bool read_double(double& out) {
+        bool is_integer;
+        size_t len = scan_number(is_integer);
+        if (len == 0) return false;
+        
+        // Up to 15 digits are exact in a double, no need for strtod()
+        size_t sign = (*curr == '-') ? 1 : 0;
+        if (is_integer && len - sign <= 15) {
+          int64_t value = 0;
+          for (size_t i = sign; i < len; ++i) value = value * 10 + (int64_t)(unit(curr[i]) - '0');
+          
+          out = (sign) ? -(double)value : (double)value;
+          curr += len;
+          return true;
+        }
+        
+        // The literal is ASCII, strtod() it from a char copy whatever the input is
+        // @HARDCODED
+        char buffer[128];
+        std::string long_number;
+        char* text = buffer;
+        if (len >= sizeof(buffer)) {
+          long_number.resize(len);
+          text = &long_number[0];
+        }
+        
+        size_t exponent = len;
+        for (size_t i = 0; i < len; ++i) {
+          text[i] = (char)curr[i];
+          if (text[i] == 'e' || text[i] == 'E') exponent = i;
+        }
+        text[len] = '\0';
+        
+        char* num_end;
+        out = strtod(text, &num_end);
+        
+        if constexpr (Options::exp_decimals) {
+          // strtod() stops at the '.' of a decimal exponent, apply the exponent ourselves
+          if (num_end < text + len) {
+            text[exponent] = '\0';
+            out = strtod(text, NULL) * pow(10.0, strtod(text + exponent + 1, NULL));
+            num_end = text + len;
+          }
+        }
+        
+        curr += len;
+        return num_end == text + len;
+      }
+      
+      bool skip_value() {
+        switch (peek()) {
+          case '"': {
+            ++curr;
+            while (curr < end && *curr != '"') {
+              if (*curr == '\\') ++curr;
+              ++curr;
+            }
+            if (curr >= end) return false;
+            ++curr;
+            return true;
+          }
+          
+          case '{':
+          case '[': {
+            char close = (*curr == '{') ? '}' : ']';
+            ++curr;
+            if (consume(close)) return true;
+            
+            do {
+              if (close == '}') {
+                const json_char* key;
+                size_t len;
+                if (!read_key(key, len) || !consume(':')) return false;
+              }
+              if (!skip_value()) return false;
+            } while (consume(','));
+            
+            return consume(close);
+          }
+          
+          case 't': return consume_word("true");
+          case 'f': return consume_word("false");
+          case 'n': return consume_word("null");
+          
+          default: {
+            double d;
+            return read_double(d);
+          }
+        }
+      }
+    };
+    
+    // Builds a tree with the C API, out is always left as something json_free() can take
+    template <typename CharT, typename Options>
+    bool read_value(reader<CharT, Options>& r, JsonValue& out) {
+      out = json_null();
+      
+      switch (r.peek()) {
+        case '"': {
+          r.scratch.clear();
+          if (!r.read_string(r.scratch)) return false;
+          out = json_string(r.scratch.c_str());
+          return true;
+        }
+        
+        case '{': {
+          ++r.curr;
+          out = json_object();
+          if (r.consume('}')) return true;
+          
+          JsonObject* last = NULL;
+          do {
+            r.scratch.clear();
+            if (!r.read_string(r.scratch) || !r.consume(':')) return false;
+            
+            // The key is copied before the value can reuse scratch
+            last = json_append_field(&out, last, r.scratch.c_str(), json_null());
+            if (!read_value(r, *last->value)) return false;
+          } while (r.consume(','));
+          
+          return r.consume('}');
+        }
+        
+        case '[': {
+          ++r.curr;
+          out = json_array();
+          if (r.consume(']')) return true;
+          
+          do {
+            json_add_element(&out, json_null());
+            if (!read_value(r, out.array_value->values[out.array_value->count - 1])) return false;
+          } while (r.consume(','));
+          
+          return r.consume(']');
+        }
+        
+        case 't': out = json_boolean(1); return r.consume_word("true");
+        case 'f': out = json_boolean(0); return r.consume_word("false");
+        case 'n': return r.consume_word("null");
+        
+        default: {
+          double d;
+          if (!r.read_double(d)) return false;
+          out = json_number(d);
+          return true;
+        }
+      }
+    }
+    
+    template <typename R, typename T>
+    bool read(R& r, T& out);
+    
+    template <typename R, typename T, size_t... I>
+    bool read_field(R& r, T& out, int32_t index, std::index_sequence<I...>) {
+      bool ok = true;
+      ((index == (int32_t)I ? (ok = read(r, out.*(std::get<I>(bound_fields<T>::fields).member)), true) : false) || ...);
+      return ok;
+    }
+    
+    template <typename R, typename T>
+    bool read_object(R& r, T& out) {
+      typedef bound_fields<T> B;
+      
+      if (!r.consume('{')) return false;
+      if (r.consume('}')) return true;
+      
+      do {
+        const json_char* key;
+        size_t len;
+        if (!r.read_key(key, len) || !r.consume(':')) return false;
+        
+        int32_t index = B::table.find(key, len);
+        if (index >= 0) {
+          const json_char* name = B::names[index];
+          if (length(name) != len || !std::equal(key, key + len, name)) index = -1;
+        }
+        
+        if (index < 0) {
+          if (!r.skip_value()) return false;
+        } else if (!read_field(r, out, index, std::make_index_sequence<B::COUNT>())) {
+          return false;
+        }
+      } while (r.consume(','));
+      
+      return r.consume('}');
+    }
+    
+    template <typename R, typename T>
+    bool read(R& r, T& out) {
+      if constexpr (std::is_same<T, bool>::value) {
+        if (r.consume_word("true")) out = true;
+        else if (r.consume_word("false")) out = false;
+        else return false;
+        return true;
+      } else if constexpr (std::is_integral<T>::value) {
+        return r.read_integer(out);
+      } else if constexpr (std::is_floating_point<T>::value) {
+        double d;
+        if (!r.read_double(d)) return false;
+        out = (T)d;
+        return true;
+      } else if constexpr (std::is_same<T, std::basic_string<json_char>>::value) {
+        out.clear();
+        return r.read_string(out);
+      } else if constexpr (is_optional<T>::value) {
+        if (r.consume_word("null")) {
+          out.reset();
+          return true;
+        }
+        return read(r, out.emplace());
+      } else if constexpr (is_vector<T>::value) {
+        out.clear();
+        if (!r.consume('[')) return false;
+        if (r.consume(']')) return true;
+        
+        do {
+          if (!read(r, out.emplace_back())) return false;
+        } while (r.consume(','));
+        
+        return r.consume(']');
+      } else {
+        static_assert(is_bound<T>::value, "Type needs a JSON_BIND declaration");
+        return read_object(r, out);
+      }
+    }
+    
+    inline void write_string(std::basic_string<json_char>& out, const json_char* str, size_t len) {
+      static const char HEX[] = "0123456789abcdef";
+      
+      out += JSTR('"');
+      for (size_t i = 0; i < len; ++i) {
+        json_char c = str[i];
+        switch (c) {
+          case JSTR('"'):  out += JSTR("\\\""); break;
+          case JSTR('\\'): out += JSTR("\\\\"); break;
+          case JSTR('\b'): out += JSTR("\\b"); break;
+          case JSTR('\f'): out += JSTR("\\f"); break;
+          case JSTR('\n'): out += JSTR("\\n"); break;
+          case JSTR('\r'): out += JSTR("\\r"); break;
+          case JSTR('\t'): out += JSTR("\\t"); break;
+          default: {
+            if ((uint32_t)c < 0x20) {
+              out += JSTR("\\u00");
+              out += (json_char)HEX[(c >> 4) & 0xF];
+              out += (json_char)HEX[c & 0xF];
+            } else {
+              out += c;
+            }
+          }
+        }
+      }
+      out += JSTR('"');
+    }
+    
+    template <typename T>
+    void write(std::basic_string<json_char>& out, const T& value);
+    
+    template <typename T, size_t... I>
+    void write_object(std::basic_string<json_char>& out, const T& value, std::index_sequence<I...>) {
+      out += JSTR('{');
+      ((out += (I == 0) ? JSTR("") : JSTR(","),
+        write_string(out, std::get<I>(bound_fields<T>::fields).name, length(std::get<I>(bound_fields<T>::fields).name)),
+        out += JSTR(':'),
+        write(out, value.*(std::get<I>(bound_fields<T>::fields).member))), ...);
+      out += JSTR('}');
+    }
+    
+    template <typename T>
+    void write(std::basic_string<json_char>& out, const T& value) {
+      if constexpr (std::is_same<T, bool>::value) {
+        out += (value) ? JSTR("true") : JSTR("false");
+      } else if constexpr (std::is_integral<T>::value) {
+        json_char buffer[24];
+        json_char* p = buffer + 24;
+        
+        typedef std::make_unsigned_t<T> U;
+        U magnitude = (value < 0) ? (U)(0 - (U)value) : (U)value;
+        do {
+          *--p = (json_char)(JSTR('0') + magnitude % 10);
+          magnitude /= 10;
+        } while (magnitude);
+        if (value < 0) *--p = JSTR('-');
+        
+        out.append(p, buffer + 24);
+      } else if constexpr (std::is_floating_point<T>::value) {
+        char buffer[32];
+        int len = snprintf(buffer, sizeof(buffer), "%.17g", (double)value);
+        
+        // Non-finite numbers don't exist in JSON
+        if (value != value || value - value != 0) {
+          out += JSTR("null");
+        } else {
+          out.append(buffer, buffer + len);
+        }
+      } else if constexpr (std::is_same<T, std::basic_string<json_char>>::value) {
+        write_string(out, value.data(), value.size());
+      } else if constexpr (is_optional<T>::value) {
+        if (value) write(out, *value);
+        else out += JSTR("null");
+      } else if constexpr (is_vector<T>::value) {
+        out += JSTR('[');
+        for (size_t i = 0; i < value.size(); ++i) {
+          if (i > 0) out += JSTR(',');
+          write(out, value[i]);
+        }
+        out += JSTR(']');
+      } else {
+        static_assert(is_bound<T>::value, "Type needs a JSON_BIND declaration");
+        write_object(out, value, std::make_index_sequence<bound_fields<T>::COUNT>());
+      }
+    }
+    
+  } // namespace detail
+  
+  template <typename Options = parse_options, typename CharT, typename T>
+  bool decode(const CharT* text, size_t length, T& out) {
+    detail::reader<CharT, Options> r = { text, text + length, {} };
+    if (!detail::read(r, out)) return false;
+    
+    r.skip_whitespace();
+    return r.curr == r.end;
+  }
+  
+  template <typename Options = parse_options, typename CharT, typename T>
+  bool decode(const CharT* text, T& out) {
+    return decode<Options>(text, detail::length(text), out);
+  }
+  
+  template <typename T>
+  void encode(const T& value, std::basic_string<json_char>& out) {
+    detail::write(out, value);
+  }
+  
+  template <typename T>
+  std::basic_string<json_char> encode(const T& value) {
+    std::basic_string<json_char> out;
+    detail::write(out, value);
+    return out;
+  }
+  
+} // namespace json
+
+// C++17 ownership wrapper
+// json::Document owns a tree and frees it in its destructor. It can be moved but not copied, use clone() or share():
+//   json::Document doc = json::Document::parse(JSTR("{ \"hosts\": [ \"a\", \"b\" ], \"port\": 80 }"));
+//   std::optional<double> port = doc[JSTR("port")].number();
+//
+//   for (json::Value host : doc[JSTR("hosts")].elements()) { ... }
+//   for (auto [key, value] : doc.root().members()) { ... }
+//
+//   next_stage(std::move(doc));
+//
+// json::Value is a non-owning view into a Document. Lookups that miss return an empty Value,
+// and every accessor of an empty Value or a Value of another type returns std::nullopt.
+// Views don't keep the Document alive. JSON_NUMBER_ARRAY has no elements(), use json_number_array_get().
+//
+// json::parse() builds a Document from text of any character type, transcoding strings to json_char:
+//   json::Document doc;
+//   json::parse(u"[ \"a\", \"b\" ]", doc);
+
+namespace json {
+  
+  using string_view = std::basic_string_view<json_char>;
+  
+  class Value;
+  
+  class ElementIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Value;
+    
+    explicit ElementIterator(JsonValue* curr) : curr_(curr) {}
+    
+    Value operator*() const;
+    ElementIterator& operator++() { ++curr_; return *this; }
+    bool operator==(const ElementIterator& other) const { return curr_ == other.curr_; }
+    bool operator!=(const ElementIterator& other) const { return curr_ != other.curr_; }
+    
+  private:
+    JsonValue* curr_;
+  };
+  
+  class MemberIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<string_view, Value>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+    
+    explicit MemberIterator(JsonObject* curr) : curr_(curr) { skip_empty(); }
+    
+    std::pair<string_view, Value> operator*() const;
+    MemberIterator& operator++() { curr_ = curr_->next; skip_empty(); return *this; }
+    bool operator==(const MemberIterator& other) const { return curr_ == other.curr_; }
+    bool operator!=(const MemberIterator& other) const { return curr_ != other.curr_; }
+    
+  private:
+    // Nodes without a key are placeholders of empty objects
+    void skip_empty() { while (curr_ && !curr_->key) curr_ = curr_->next; }
+    
+    JsonObject* curr_;
+  };
+  
+  template <typename Iterator>
+  struct Range {
+    Iterator first;
+    Iterator last;
+    
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
+  };
+  
+  class Value {
+  public:
+    Value() = default;
+    explicit Value(JsonValue* value) : value_(value) {}
+    
+    JsonValue* get() const { return value_; }
+    explicit operator bool() const { return value_ != nullptr; }
+    
+    JsonType type() const { return (value_) ? value_->type : JSON_NULL; }
+    bool is_null() const { return type() == JSON_NULL; }
+    bool is_bool() const { return type() == JSON_BOOL; }
+    bool is_number() const { return type() == JSON_NUMBER || type() == JSON_RAW_NUMBER; }
+    bool is_string() const { return type() == JSON_STRING; }
+    bool is_array() const { return type() == JSON_ARRAY || type() == JSON_NUMBER_ARRAY; }
+    bool is_object() const { return type() == JSON_OBJECT; }
+    
+    std::optional<bool> boolean() const {
+      if (!is_bool()) return std::nullopt;
+      return value_->bool_value != 0;
+    }
+    
+    std::optional<double> number() const {
+      if (!is_number()) return std::nullopt;
+      return json_get_number(value_);
+    }
+    
+    std::optional<int64_t> int64() const {
+      if (!is_number()) return std::nullopt;
+      return json_get_int64(value_);
+    }
+    
+    std::optional<string_view> string() const {
+      if (!is_string()) return std::nullopt;
+      return string_view(value_->string_value);
+    }
+    
+    // Empty Value if the key doesn't exist
+    Value operator[](string_view key) const {
+      if (!is_object()) return Value();
+      
+      uint32_t hash = 2166136261u;
+      for (json_char ch : key) hash = (hash ^ (uint32_t)ch) * 16777619u;
+      
+      for (JsonObject* obj = value_->object_value; obj != nullptr; obj = obj->next) {
+        if (obj->key && obj->key_hash == hash && key == obj->key) return Value(obj->value);
+      }
+      
+      return Value();
+    }
+    
+    // Empty Value if the index is out of range
+    Value operator[](size_t index) const {
+      if (type() != JSON_ARRAY || index >= value_->array_value->count) return Value();
+      return Value(&value_->array_value->values[index]);
+    }
+    
+    std::optional<Value> find(string_view key) const {
+      Value value = (*this)[key];
+      if (!value) return std::nullopt;
+      return value;
+    }
+    
+    size_t size() const {
+      switch (type()) {
+        case JSON_ARRAY: return value_->array_value->count;
+        case JSON_NUMBER_ARRAY: return value_->number_array_value->count;
+        case JSON_OBJECT: {
+          size_t count = 0;
+          for (JsonObject* obj = value_->object_value; obj != nullptr; obj = obj->next) {
+            if (obj->key) ++count;
+          }
+          return count;
+        }
+        default: return 0;
+      }
+    }
+    
+    Range<ElementIterator> elements() const {
+      if (type() != JSON_ARRAY) return { ElementIterator(nullptr), ElementIterator(nullptr) };
+      
+      JsonValue* values = value_->array_value->values;
+      return { ElementIterator(values), ElementIterator(values + value_->array_value->count) };
+    }
+    
+    Range<MemberIterator> members() const {
+      if (!is_object()) return { MemberIterator(nullptr), MemberIterator(nullptr) };
+      return { MemberIterator(value_->object_value), MemberIterator(nullptr) };
+    }
+    
+  private:
+    JsonValue* value_ = nullptr;
+  };
+  
+  inline Value ElementIterator::operator*() const {
+    return Value(curr_);
+  }
+  
+  inline std::pair<string_view, Value> MemberIterator::operator*() const {
+    return { string_view(curr_->key), Value(curr_->value) };
+  }
+  
+  class Document {
+  public:
+    Document() : value_(), allocator_(json_get_allocator()) {}
+    
+    // Takes ownership of the tree, which is freed with the allocator that built it
+    explicit Document(JsonValue value, const JsonAllocator* allocator = json_get_allocator())
+      : value_(value), allocator_(allocator) {}
+    
+    static Document parse(const json_char* text, uint32_t flags = 0, const JsonAllocator* allocator = json_get_allocator()) {
+      return Document(json_parse_with(text, flags, allocator), allocator);
+    }
+    
+    static Document parse_file(const char* path) {
+      return Document(json_parse_from_file(path));
+    }
+    
+    ~Document() { json_free_with(&value_, allocator_); }
+    
+    Document(Document&& other) noexcept : value_(other.value_), allocator_(other.allocator_) { other.value_ = JsonValue(); }
+    
+    Document& operator=(Document&& other) noexcept {
+      if (this != &other) {
+        json_free_with(&value_, allocator_);
+        value_ = other.value_;
+        allocator_ = other.allocator_;
+        other.value_ = JsonValue();
+      }
+      return *this;
+    }
+    
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+    
+    // Deep copy, optionally into another allocator
+    Document clone() const { return clone(allocator_); }
+    Document clone(const JsonAllocator* allocator) const {
+      return Document(json_duplicate_with(const_cast<JsonValue*>(&value_), allocator), allocator);
+    }
+    
+    // O(1) copy-on-write copy, see json_share()
+    Document share() const { return Document(json_share(const_cast<JsonValue*>(&value_)), allocator_); }
+    
+    const JsonAllocator* allocator() const { return allocator_; }
+    
+    // Gives up ownership, the caller has to json_free() it
+    JsonValue release() {
+      JsonValue value = value_;
+      value_ = JsonValue();
+      return value;
+    }
+    
+    JsonValue* get() { return &value_; }
+    Value root() { return Value(&value_); }
+    
+    Value operator[](string_view key) { return root()[key]; }
+    Value operator[](size_t index) { return root()[index]; }
+    
+  private:
+    JsonValue value_;
+    const JsonAllocator* allocator_;
+  };
+  
+  // Sets the allocator of the current thread until the end of the scope
+  class AllocatorScope {
+  public:
+    explicit AllocatorScope(const JsonAllocator* allocator) : previous_(json_set_allocator(allocator)) {}
+    ~AllocatorScope() { json_set_allocator(previous_); }
+    
+    AllocatorScope(const AllocatorScope&) = delete;
+    AllocatorScope& operator=(const AllocatorScope&) = delete;
+    
+  private:
+    const JsonAllocator* previous_;
+  };
+  
+  // Builds a tree from text of any character type, in the allocator of out
+  template <typename Options = parse_options, typename CharT>
+  bool parse(const CharT* text, size_t length, Document& out) {
+    AllocatorScope scope(out.allocator());
+    
+    detail::reader<CharT, Options> r = { text, text + length, {} };
+    JsonValue value;
+    bool ok = detail::read_value(r, value);
+    if (ok) {
+      r.skip_whitespace();
+      ok = (r.curr == r.end);
+    }
+    
+    if (!ok) {
+      json_free(&value);
+      return false;
+    }
+    
+    out = Document(value, out.allocator());
+    return true;
+  }
+  
+  template <typename Options = parse_options, typename CharT>
+  bool parse(const CharT* text, Document& out) {
+    return parse<Options>(text, detail::length(text), out);
+  }
+  
+} // namespace json
+
+#endif // JSON_CPP17
+
+#endif // JSON_H_
+
+// Implementation starts here
+#ifdef JSON_IMPLEMENTATION
+#undef JSON_IMPLEMENTATION
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <stddef.h>
+  
+#if defined(__AVX2__)
+#  define JSON_AVX2
+#  include <immintrin.h>
+#endif
+  
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define JSON_SSE2
+#  include <emmintrin.h>
+#endif
+  
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+  
+#ifdef _WIN32
+// Keep min()/max() macros out of the including file, they break std::min() and numeric_limits<T>::max()
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <time.h>
+#  include <unistd.h>
+#  ifndef JSON_NO_THREADS
+#    include <pthread.h>
+#  endif
+#endif
+  
+  typedef struct JsonContext {
+    const json_char* text;
+    uint64_t len;
+    uint64_t curr;
+    
+    json_char buffer[256];
+    
+    json_bool is_parsing;
+    uint32_t flags;
+    
+    // Set when parsing through a JsonParser, used to intern keys
+    JsonParser* parser;
+    
+    // Writable alias of text when parsing in situ, strings are decoded into it
+    json_char* in_situ;
+    
+    // Set when parsing for a JsonEditor, arrays and objects are recorded here. span_base is added to the offsets,
+    // span_index is where the next value goes in its parent
+    JsonSpans* spans;
+    uint64_t span_base;
+    uint32_t span_parent;
+    uint32_t span_index;
+    
+#ifdef JSON_ENABLE_STATS
+    uint32_t depth;
+    uint32_t max_depth;
+#endif
+  } JsonContext;
+  
+#if defined(__cplusplus)
+#  define JSON_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#  define JSON_THREAD_LOCAL __declspec(thread)
+#else
+#  define JSON_THREAD_LOCAL _Thread_local
+#endif
+  
+  // Allocator of the current thread, NULL to use JSON_MALLOC/JSON_REALLOC/JSON_FREE
+  static JSON_THREAD_LOCAL const JsonAllocator* json_allocator = NULL;
+  
+  const JsonAllocator* json_set_allocator(const JsonAllocator* allocator) {
+    const JsonAllocator* previous = json_allocator;
+    json_allocator = allocator;
+    return previous;
+  }
+  
+  const JsonAllocator* json_get_allocator() {
+    return json_allocator;
+  }
+  
+#ifdef JSON_ENABLE_STATS
+  // Stats of the current thread, nothing is recorded while it's NULL
+  static JSON_THREAD_LOCAL JsonStats* json_stats = NULL;
+  
+  JsonStats* json_set_stats(JsonStats* stats) {
+    JsonStats* previous = json_stats;
+    json_stats = stats;
+    return previous;
+  }
+  
+  // Not atomic, merge per-thread stats once the threads are done or under your own lock
+  void json_stats_merge(JsonStats* into, const JsonStats* from) {
+    into->documents += from->documents;
+    into->bytes_scanned += from->bytes_scanned;
+    
+    for (uint32_t i = 0; i <= JSON_NUMBER_ARRAY; ++i) {
+      into->values[i] += from->values[i];
+    }
+    into->keys += from->keys;
+    
+    if (from->max_depth > into->max_depth) into->max_depth = from->max_depth;
+    
+    into->allocations += from->allocations;
+    into->reallocations += from->reallocations;
+    into->frees += from->frees;
+    into->bytes_allocated += from->bytes_allocated;
+    
+    into->number_time += from->number_time;
+    into->string_time += from->string_time;
+    into->structural_time += from->structural_time;
+    
+    into->bytes_written += from->bytes_written;
+  }
+  
+  static inline uint64_t json_stats_now() {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+  }
+  
+#  define JSON_STATS(statement) do { if (json_stats) { statement; } } while (0)
+#  define JSON_STATS_BEGIN(timer) uint64_t timer = (json_stats) ? json_stats_now() : 0
+#  define JSON_STATS_END(timer, field) JSON_STATS(json_stats->field += json_stats_now() - (timer))
+#else
+#  define JSON_STATS(statement)
+#  define JSON_STATS_BEGIN(timer)
+#  define JSON_STATS_END(timer, field)
+#endif
+  
+  // Everything that ends up in a JsonValue tree goes through these, buffers returned to the caller use JSON_MALLOC
+  static inline void* json_mem_alloc(size_t size) {
+    JSON_STATS(++json_stats->allocations; json_stats->bytes_allocated += size);
+    
+    if (json_allocator) return json_allocator->allocate(json_allocator->user, size);
+    return (void*)JSON_MALLOC(size);
+  }
+  
+  static inline void* json_mem_realloc(void* ptr, size_t size) {
+    JSON_STATS(++json_stats->reallocations; json_stats->bytes_allocated += size);
+    
+    if (json_allocator) return json_allocator->reallocate(json_allocator->user, ptr, size);
+    return (void*)JSON_REALLOC(ptr, size);
+  }
+  
+  static inline void json_mem_free(void* ptr) {
+    JSON_STATS(if (ptr) ++json_stats->frees);
+    
+    if (json_allocator) json_allocator->deallocate(json_allocator->user, ptr);
+    else JSON_FREE(ptr);
+  }
+  
+  // Use for buffers that are fully written before they are read (strings, element storage)
+  static inline void* json_alloc_raw(uint32_t size) {
+    return json_mem_alloc(size);
+  }
+  
+  // FNV-1a over the code units of a key
+  static uint32_t json_hash_key(const json_char* key, uint32_t* length) {
+    uint32_t hash = 2166136261u;
+    uint32_t len = 0;
+    
+    for (const json_char* k = key; *k; ++k, ++len) {
+      hash = (hash ^ (uint32_t)*k) * 16777619u;
+    }
+    
+    if (length) *length = len;
+    return hash;
+  }
+  
+  // Use for structures that rely on being zero-initialised (counts, next pointers, etc.)
+  static void* json_alloc(uint32_t size) {
+    void* ptr = json_alloc_raw(size);
+    
+#ifdef JSON_MEM_ALREADY_ZEROED
+    // Only JSON_MALLOC is known to zero
+    if (json_allocator) memset(ptr, 0, size);
+#else
+    memset(ptr, 0, size);
+#endif
+    
+    return ptr;
+  }
+  
+  // Reads a single code point from a json_char string, combining UTF-16 surrogate pairs if wchar_t is 16 bits
+  static inline uint32_t json_next_codepoint(const json_char** str) {
+    const json_char* s = *str;
+    uint32_t cp;
+    
+#ifdef JSON_USE_SINGLE_BYTE
+    // Strings are already UTF-8, callers copy bytes through unchanged
+    cp = (uint8_t)*s++;
+#else
+    cp = (uint32_t)*s++;
+    if (sizeof(json_char) == 2 && cp >= 0xD800 && cp <= 0xDBFF &&
+        (uint32_t)*s >= 0xDC00 && (uint32_t)*s <= 0xDFFF) {
+      cp = 0x10000 + ((cp - 0xD800) << 10) + ((uint32_t)*s++ - 0xDC00);
+    }
+#endif
+    
+    *str = s;
+    return cp;
+  }
+  
+  static inline uint32_t json_utf8_encode(uint32_t cp, uint8_t* out) {
+    if (cp < 0x80) {
+      out[0] = (uint8_t)cp;
+      return 1;
+    } else if (cp < 0x800) {
+      out[0] = (uint8_t)(0xC0 | (cp >> 6));
+      out[1] = (uint8_t)(0x80 | (cp & 0x3F));
+      return 2;
+    } else if (cp < 0x10000) {
+      out[0] = (uint8_t)(0xE0 | (cp >> 12));
+      out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+      out[2] = (uint8_t)(0x80 | (cp & 0x3F));
+      return 3;
+    }
+    
+    out[0] = (uint8_t)(0xF0 | (cp >> 18));
+    out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (uint8_t)(0x80 | (cp & 0x3F));
+    return 4;
+  }
+  
+  // Decodes one UTF-8 sequence, invalid bytes are passed through as-is
+  static inline uint32_t json_utf8_decode(const uint8_t* data, uint64_t size, uint64_t* i) {
+    uint8_t b = data[(*i)++];
+    
+    uint32_t extra;
+    uint32_t cp;
+    if (b < 0x80) return b;
+    else if ((b & 0xE0) == 0xC0) { extra = 1; cp = b & 0x1F; }
+    else if ((b & 0xF0) == 0xE0) { extra = 2; cp = b & 0x0F; }
+    else if ((b & 0xF8) == 0xF0) { extra = 3; cp = b & 0x07; }
+    else return b;
+    
+    if (*i + extra > size) return b;
+    
+    for (uint32_t j = 0; j < extra; ++j) {
+      cp = (cp << 6) | (data[*i + j] & 0x3F);
+    }
+    *i += extra;
+    
+    return cp;
+  }
+  
+  inline JsonValue json_null() {
+    JsonValue json = {};
+    json.type = JSON_NULL;
+    
+    return json;
+  }
+  
+  inline JsonValue json_number(double value) {
+    JsonValue json  = {};
+    json.type = JSON_NUMBER;
+    json.number_value = value;
+    
+    return json;
+  }
+  
+  inline JsonValue json_string(const json_char* value) {
+    JsonValue json  = {};
+    json.type = JSON_STRING;
+    json.string_value = (json_char*)json_alloc_raw(((uint32_t)json_strlen(value) + 1) * sizeof(json_char));
+    json_strcpy(json.string_value, value);
+    
+    return json;
+  }
+  
+  inline JsonValue json_string_char(json_char value) {
+    JsonValue json  = {};
+    json.type = JSON_STRING;
+    json.string_value = (json_char*)json_alloc_raw(2 * sizeof(json_char));
+    json.string_value[0] = value;
+    json.string_value[1] = JSTR('\0');
+    
+    return json;
+  }
+  
+  static inline JsonObject* json_alloc_object(const json_char* key, JsonValue value) {
+    JsonObject* object_value = (JsonObject*)json_alloc(sizeof(JsonObject)); 
+    object_value->key = (json_char*)json_alloc_raw(((uint32_t)json_strlen(key) + 1) * sizeof(json_char));
+    json_strcpy(object_value->key, key);
+    object_value->key_hash = json_hash_key(key, NULL);
+    
+    object_value->value = (JsonValue*)json_alloc_raw(sizeof(JsonValue));
+    *object_value->value = value;
+    
+    return object_value;
+  }
+  
+  inline JsonValue json_object() {
+    JsonValue json  = {};
+    json.type = JSON_OBJECT;
+    
+    return json;
+  }
+  
+  // Copies keys that point into the parsed text, so the object can mix them with keys it owns
+  static void json_own_keys(JsonValue* json) {
+    if (!(json->flags & JSON_VALUE_BORROWED)) return;
+    
+    for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+      if (!obj->key) continue;
+      
+      json_char* key = (json_char*)json_alloc_raw(((uint32_t)json_strlen(obj->key) + 1) * sizeof(json_char));
+      json_strcpy(key, obj->key);
+      obj->key = key;
+    }
+    
+    json->flags &= ~JSON_VALUE_BORROWED;
+  }
+  
+  inline void json_add_field(JsonValue* json, const json_char* key, JsonValue value) {
+    assert(json->type == JSON_OBJECT);
+    
+    json_make_unique(json);
+    json_own_keys(json);
+    
+    if (!json->object_value) {
+      json->object_value = json_alloc_object(key, value);
+    } else {
+      JsonObject* curr = json->object_value;
+      for (;;) {
+        if (curr->next) {
+          curr = curr->next;
+        } else {
+          curr->next = json_alloc_object(key, value);
+          break;
+        }
+      }
+    }
+  }
+  
+  JsonObject* json_append_field(JsonValue* json, JsonObject* last, const json_char* key, JsonValue value) {
+    assert(json->type == JSON_OBJECT);
+    
+    // Only the first call has to check for sharing and find the tail
+    if (!last) {
+      json_make_unique(json);
+      json_own_keys(json);
+      
+      for (last = json->object_value; last && last->next; last = last->next);
+    }
+    
+    JsonObject* node = json_alloc_object(key, value);
+    if (last) last->next = node;
+    else json->object_value = node;
+    
+    return node;
+  }
+  
+  inline JsonValue json_array() {
+    JsonValue json  = {};
+    json.type = JSON_ARRAY;
+    
+    json.array_value = (JsonArray*)json_alloc(sizeof(JsonArray));
+    
+    return json;
+  }
+  
+  inline void json_add_element(JsonValue* json, JsonValue value) {
+    // @HARDCODED
+    const int ARRAY_START_SIZE = 32;
+    
+    json_make_unique(json);
+    
+    if (!json->array_value->values) {
+      json->array_value->capacity = ARRAY_START_SIZE;
+      json->array_value->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * json->array_value->capacity);
+    } else if (json->array_value->count >= json->array_value->capacity) {
+      // Double the capacity
+      json->array_value->capacity *= 2;
+      json->array_value->values = (JsonValue*)json_mem_realloc(json->array_value->values,
+                                                           sizeof(JsonValue) * json->array_value->capacity);
+    }
+    
+    json->array_value->values[json->array_value->count++] = value;
+  }
+  
+  inline void json_remove_element(JsonValue* json, uint32_t index) {
+    if (index >= json->array_value->count || !json->array_value->values) return;
+    
+    json_make_unique(json);
+    
+    // Free the value
+    json_free(&json->array_value->values[index]);
+    
+    // If it's the last element, just decrease the count
+    if (index == json->array_value->count - 1) {
+      --json->array_value->count;
+    } else {
+      // Else, move everything after it over it
+      memmove(json->array_value->values + index, json->array_value->values + (index + 1),
+              (json->array_value->count - index - 1) * sizeof(JsonValue));
+      --json->array_value->count;
+    }
+  }
+  
+  inline JsonValue json_boolean(json_bool value) {
+    JsonValue json = {};
+    json.type = JSON_BOOL;
+    json.bool_value = value;
+    return json;
+  }
+  
+  static void json_number_array_reserve(JsonNumberArray* arr, uint32_t count) {
+    if (count <= arr->capacity) return;
+    
+    // @HARDCODED
+    uint32_t capacity = (arr->capacity) ? arr->capacity : 32;
+    while (capacity < count) capacity *= 2;
+    
+    if (arr->doubles) arr->doubles = (double*)json_mem_realloc(arr->doubles, sizeof(double) * capacity);
+    else arr->doubles = (double*)json_alloc_raw(sizeof(double) * capacity);
+    arr->capacity = capacity;
+  }
+  
+  // Converts the elements in place, both are 8 bytes wide
+  static void json_number_array_to_doubles(JsonNumberArray* arr) {
+    if (!arr->is_integer) return;
+    
+    for (uint32_t i = 0; i < arr->count; ++i) {
+      double value = (double)arr->integers[i];
+      memcpy(&arr->doubles[i], &value, sizeof(double));
+    }
+    
+    arr->is_integer = 0;
+  }
+  
+  JsonValue json_number_array(const double* values, uint32_t count) {
+    JsonValue json = {};
+    json.type = JSON_NUMBER_ARRAY;
+    json.number_array_value = (JsonNumberArray*)json_alloc(sizeof(JsonNumberArray));
+    
+    if (count > 0) {
+      json_number_array_reserve(json.number_array_value, count);
+      memcpy(json.number_array_value->doubles, values, sizeof(double) * count);
+      json.number_array_value->count = count;
+    }
+    
+    return json;
+  }
+  
+  JsonValue json_int64_array(const int64_t* values, uint32_t count) {
+    JsonValue json = json_number_array(NULL, 0);
+    json.number_array_value->is_integer = 1;
+    
+    if (count > 0) {
+      json_number_array_reserve(json.number_array_value, count);
+      memcpy(json.number_array_value->integers, values, sizeof(int64_t) * count);
+      json.number_array_value->count = count;
+    }
+    
+    return json;
+  }
+  
+  void json_add_number(JsonValue* json, double value) {
+    assert(json->type == JSON_NUMBER_ARRAY);
+    
+    json_make_unique(json);
+    
+    JsonNumberArray* arr = json->number_array_value;
+    json_bool integral = fmod(value, 1.0) == 0.0 && fabs(value) < 1e18;
+    if (arr->is_integer && !integral) json_number_array_to_doubles(arr);
+    
+    json_number_array_reserve(arr, arr->count + 1);
+    if (arr->is_integer) arr->integers[arr->count++] = (int64_t)value;
+    else arr->doubles[arr->count++] = value;
+  }
+  
+  double json_number_array_get(JsonValue* json, uint32_t index) {
+    if (!json || json->type != JSON_NUMBER_ARRAY || index >= json->number_array_value->count) return 0.0;
+    
+    JsonNumberArray* arr = json->number_array_value;
+    return (arr->is_integer) ? (double)arr->integers[index] : arr->doubles[index];
+  }
+  
+  void json_number_array_expand(JsonValue* json) {
+    if (!json || json->type != JSON_NUMBER_ARRAY) return;
+    
+    JsonNumberArray* arr = json->number_array_value;
+    
+    JsonValue expanded = json_array();
+    if (arr->count > 0) {
+      expanded.array_value->capacity = arr->count;
+      expanded.array_value->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->count);
+      
+      for (uint32_t i = 0; i < arr->count; ++i) {
+        expanded.array_value->values[i] = json_number(json_number_array_get(json, i));
+      }
+      expanded.array_value->count = arr->count;
+    }
+    
+    json_free(json);
+    *json = expanded;
+  }
+  
+  static void json_read(JsonContext* c, uint32_t count) {
+    if (c->curr + count <= c->len) {
+      json_strncpy(c->buffer, (c->text + c->curr), count);
+      c->curr += count;
+      c->buffer[count] = JSTR('\0');
+    } else {
+      c->buffer[0] = JSTR('\0');
+      c->is_parsing = 0;
+    }
+  }
+  
+  static json_char json_get(JsonContext* c) {
+    // Get next json_character, skip any whitespace
+    do {
+      json_read(c, 1);
+    } while (isspace(c->buffer[0]));
+    
+    return c->buffer[0];
+  }
+  
+  static json_char json_peek(JsonContext* c) {
+    json_char peek = json_get(c);
+    c->curr--;
+    
+    return peek;
+  }
+  
+  static inline json_bool json_is_digit(json_char c) {
+    return c >= JSTR('0') && c <= JSTR('9');
+  }
+  
+  // Length of the number literal at the start of str, 0 if it isn't one
+  static uint32_t json_number_length(const json_char* str) {
+    const json_char* p = str;
+    
+    if (*p == JSTR('-')) ++p;
+    if (!json_is_digit(*p)) return 0;
+    while (json_is_digit(*p)) ++p;
+    
+    if (*p == JSTR('.') && json_is_digit(p[1])) {
+      ++p;
+      while (json_is_digit(*p)) ++p;
+    }
+    
+    if (*p == JSTR('e') || *p == JSTR('E')) {
+      const json_char* exp = p + 1;
+      if (*exp == JSTR('+') || *exp == JSTR('-')) ++exp;
+      
+      // Leave a dangling 'e' for the caller to trip over
+      if (json_is_digit(*exp)) {
+        while (json_is_digit(*exp)) ++exp;
+        
+#ifdef JSON_ALLOW_EXP_DECIMALS
+        if (*exp == JSTR('.') && json_is_digit(exp[1])) {
+          ++exp;
+          while (json_is_digit(*exp)) ++exp;
+        }
+#endif
+        
+        p = exp;
+      }
+    }
+    
+    return (uint32_t)(p - str);
+  }
+  
+  // Whether a literal found by json_number_length() has no fraction or exponent
+  static inline json_bool json_is_integer_literal(const json_char* str, uint32_t length) {
+    uint32_t i = (str[0] == JSTR('-')) ? 1 : 0;
+    while (i < length && json_is_digit(str[i])) ++i;
+    
+    return i == length;
+  }
+  
+  // Converts a literal found by json_number_length()
+  static double json_number_from_text(const json_char* str, uint32_t length) {
+    json_char* end = NULL;
+    double num = json_strtod(str, &end);
+    
+#ifdef JSON_ALLOW_EXP_DECIMALS
+    // strtod() stops at the '.' of a decimal exponent, apply the exponent ourselves
+    if (end < str + length) {
+      json_char mantissa[64];
+      uint32_t e = 0;
+      while (e < length && str[e] != JSTR('e') && str[e] != JSTR('E')) ++e;
+      if (e >= 64) e = 63;
+      
+      memcpy(mantissa, str, e * sizeof(json_char));
+      mantissa[e] = JSTR('\0');
+      
+      num = json_strtod(mantissa, NULL) * pow(10.0, json_strtod(str + e + 1, NULL));
+    }
+#else
+    (void)length;
+#endif
+    
+    return num;
+  }
+  
+  static void json_parse_number(JsonContext* c, JsonValue* value) {
+    // json_peek() has skipped any whitespace
+    json_peek(c);
+    
+    const json_char* start = c->text + c->curr;
+    uint32_t length = json_number_length(start);
+    
+    if (length == 0) {
+      json_printf(JSTR("Invalid number\n"));
+      c->is_parsing = 0;
+      return;
+    }
+    
+    if (c->flags & JSON_PARSE_LAZY_NUMBERS) {
+      value->type = JSON_RAW_NUMBER;
+      value->raw_number = start;
+    } else {
+      value->type = JSON_NUMBER;
+      value->number_value = json_number_from_text(start, length);
+    }
+    
+    c->curr += length;
+  }
+  
+  static json_char* json_parse_string(JsonContext* c) {
+    // Consume starting quote
+    json_read(c, 1);
+    
+    // Remember file position
+    uint64_t string_start = c->curr;
+    
+    json_char* str;
+    if (c->in_situ) {
+      // Unescaping never makes a string longer, so it's decoded over its own text
+      str = c->in_situ + string_start;
+    } else {
+      // Calculate string length
+      uint32_t string_length = 0;
+      do {
+        json_read(c, 1);
+        
+        if (c->buffer[0] == JSTR('\\')) {
+          json_read(c, 1);
+          
+          switch (c->buffer[0]) {
+            case JSTR('"'):
+            case JSTR('\\'):
+            case JSTR('/'):
+            case JSTR('b'):
+            case JSTR('f'):
+            case JSTR('n'):
+            case JSTR('r'):
+            case JSTR('t'): 
+            case JSTR('u'): {
+              // Only 1 json_character
+              ++string_length;
+              break;
+            }
+            
+            default: {
+              string_length += 2;
+            }
+          }
+        } else {
+          if (c->buffer[0] == JSTR('"')) break;
+          ++string_length;
+        }
+      } while (c->is_parsing);
+      
+      str = (json_char*)json_alloc_raw((string_length + 1) * sizeof(json_char));
+      c->curr = string_start;
+    }
+    
+    // Calculate string length
+    int curr = 0;
+    do {
+      json_read(c, 1);
+      
+      if (c->buffer[0] == JSTR('\\')) {
+        json_read(c, 1);
+        
+        switch (c->buffer[0]) {
+          case JSTR('"'):  str[curr++] = JSTR('\"'); break;
+          case JSTR('\\'): str[curr++] = JSTR('\\'); break;
+          case JSTR('/'):  str[curr++] = JSTR('/'); break;
+          case JSTR('b'):  str[curr++] = JSTR('\b'); break;
+          case JSTR('f'):  str[curr++] = JSTR('\f'); break;
+          case JSTR('n'):  str[curr++] = JSTR('\n'); break;
+          case JSTR('r'):  str[curr++] = JSTR('\r'); break;
+          case JSTR('t'):  str[curr++] = JSTR('\t'); break;
+          
+          case JSTR('u'): {
+            // Read 4 hex digits
+            json_read(c, 4);
+            
+            int valid = 0;
+            for (int i = 0; i < 4; ++i) {
+              json_char h = c->buffer[i];
+              valid += ((h >= JSTR('A') && h <= JSTR('F')) ||
+                        (h >= JSTR('a') && h <= JSTR('f')) ||
+                        isdigit(h));
+            }
+            
+            if (valid == 4) {
+              int hex_num;
+              json_scanf(c->buffer, JSTR("%x"), &hex_num);
+              
+              if (hex_num > JSON_CHAR_MAX) {
+                json_printf(JSTR("Warning: unicode codepoint \\u%s doesn't fit\n"), c->buffer);
+                json_printf(JSTR("    Decimal value: %d\n    Max value: %d\n"), hex_num, JSON_CHAR_MAX);
+                str[curr++] = JSTR('?');
+              } else {
+                str[curr++] = (json_char)hex_num;
+              }
+            } else {
+              for (int i = 0; i < 5; ++i) {
+                str[curr++] = c->buffer[i];
+              }
+            }
+            break;
+          }
+          
+          default: {
+            str[curr++] = c->buffer[0];
+            str[curr++] = c->buffer[1];
+          }
+        }
+      } else {
+        if (c->buffer[0] == JSTR('"')) break;
+        
+        str[curr++] = c->buffer[0];
+      }
+    } while (c->is_parsing);
+    
+    str[curr] = JSTR('\0');
+    
+    return str;
+  }
+  
+  static void json_parse_value(JsonContext* c, JsonValue* value);
+  
+  static JsonArray* json_parse_array(JsonContext* c) {
+    // Consume tarting bracket
+    json_read(c, 1);
+    
+    // @HARDCODED
+    const int ARRAY_START_SIZE = 32;
+    
+    JsonArray* arr = (JsonArray*)json_alloc(sizeof(JsonArray));
+    if (json_peek(c) != JSTR(']')) {
+      // Initial value
+      arr->capacity = ARRAY_START_SIZE;
+      arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->capacity);
+      
+      while (1) {
+        if (arr->count >= arr->capacity) {
+          // Double the capacity
+          arr->capacity *= 2;
+          arr->values = (JsonValue*)json_mem_realloc(arr->values, sizeof(JsonValue) * arr->capacity);
+        }
+        
+        c->span_index = arr->count;
+        json_parse_value(c, &arr->values[arr->count++]);
+        
+        json_char next = json_get(c);
+        
+        if (next == JSTR(']')) break;
+        if (next != JSTR(',')) {
+          json_printf(JSTR("Unknown token in array '%c'\n"), next);
+          c->is_parsing = 0;
+          break;
+        }
+      }
+    } else {
+      // Consume closing bracket
+      json_read(c, 1);
+    }
+    
+    return arr;
+  }
+  
+  // Parses an array that only holds numbers, returns 0 and rewinds if it holds anything else
+  static json_bool json_parse_number_array(JsonContext* c, JsonValue* value) {
+    uint64_t start = c->curr;
+    json_bool was_parsing = c->is_parsing;
+    
+    // Consume starting bracket
+    json_read(c, 1);
+    
+    // Empty arrays stay a JSON_ARRAY so elements of any type can be added
+    if (json_peek(c) == JSTR(']')) {
+      c->curr = start;
+      return 0;
+    }
+    
+    JsonNumberArray* arr = (JsonNumberArray*)json_alloc(sizeof(JsonNumberArray));
+    arr->is_integer = 1;
+    
+    while (1) {
+      json_peek(c);
+      
+      const json_char* literal = c->text + c->curr;
+      uint32_t length = json_number_length(literal);
+      if (length == 0) break;
+      
+      json_number_array_reserve(arr, arr->count + 1);
+      
+      // 18 digits always fit in an int64_t
+      if (arr->is_integer && json_is_integer_literal(literal, length) && length <= 18) {
+        arr->integers[arr->count++] = (int64_t)json_strtoll(literal, NULL, 10);
+      } else {
+        json_number_array_to_doubles(arr);
+        arr->doubles[arr->count++] = json_number_from_text(literal, length);
+      }
+      
+      c->curr += length;
+      
+      json_char next = json_get(c);
+      if (next == JSTR(']')) {
+        value->type = JSON_NUMBER_ARRAY;
+        value->number_array_value = arr;
+        
+        JSON_STATS(json_stats->values[JSON_NUMBER] += arr->count);
+        return 1;
+      }
+      
+      if (next != JSTR(',')) break;
+    }
+    
+    // Let json_parse_array() handle it, including reporting errors
+    json_mem_free(arr->doubles);
+    json_mem_free(arr);
+    
+    c->curr = start;
+    c->is_parsing = was_parsing;
+    return 0;
+  }
+  
+  static void json_parser_intern(JsonParser* parser, JsonObject* field);
+  
+  static json_bool json_parse_field(JsonContext* c, JsonObject* curr) {
+    JsonValue tmp  = {};
+    json_parse_value(c, &tmp);
+    
+    if (tmp.type != JSON_STRING) {
+      json_printf(JSTR("Object field must be string\n"));
+      json_free(&tmp);
+      c->is_parsing = 0;
+      return 0;
+    }
+    
+    curr->key = tmp.string_value;
+    curr->key_hash = json_hash_key(curr->key, NULL);
+    
+    // json_parse_value() counted it as a string
+    JSON_STATS(if (c->is_parsing) { --json_stats->values[JSON_STRING]; ++json_stats->keys; });
+    
+    if (json_get(c) != JSTR(':')) {
+      json_printf(JSTR("Expected ':' in object\n"));
+      c->is_parsing = 0;
+      
+      if (!c->in_situ) json_mem_free(curr->key);
+      curr->key = NULL;
+      return 0;
+    }
+    
+    // Keys decoded in situ cost nothing already
+    if (c->parser && !c->in_situ) json_parser_intern(c->parser, curr);
+    
+    curr->value = (JsonValue*)json_alloc(sizeof(JsonValue));
+    json_parse_value(c, curr->value);
+    return 1;
+  }
+  
+  static JsonObject* json_parse_object(JsonContext* c) {
+    // Consume starting brace
+    json_read(c, 1);
+    
+    JsonObject* head = (JsonObject*)json_alloc(sizeof(JsonObject));
+    JsonObject* prev = head;
+    
+    if (json_peek(c) != JSTR('}')) {
+      c->span_index = 0;
+      json_parse_field(c, head);
+      
+      json_char next = json_get(c);
+      if (next == JSTR('}') || next != JSTR(',')) {
+        if (next != JSTR('}') && next != JSTR(',')) {
+          json_printf(JSTR("Unknown token in object '%c'\n"), next);
+          c->is_parsing = 0;
+        }
+        return head;
+      }
+      
+      uint32_t index = 1;
+      while (1) {
+        JsonObject* curr = (JsonObject*)json_alloc(sizeof(JsonObject));
+        
+        c->span_index = index++;
+        if (!json_parse_field(c, curr)) {
+          json_mem_free(curr);
+          break;
+        }
+        
+        prev->next = curr;
+        prev = curr;
+        
+        next = json_get(c);
+        if (next == JSTR('}')) break;
+        if (next != JSTR(',')) {
+          json_printf(JSTR("Unknown token in object '%c'\n"), next);
+          c->is_parsing = 0;
+          break;
+        }
+      }
+    } else {
+      // Consume closing bracket
+      json_read(c, 1);
+    }
+    
+    return head;
+  }
+  
+#ifdef JSON_ALLOW_COMMENTS
+  static void json_parse_comment(JsonContext* c) {
+    // Consume #
+    json_read(c, 1);
+    
+    // Skip to newline
+    while (c->buffer[0] != JSTR('\n')) {
+      json_read(c, 1);
+    }
+    
+    // Consume \n
+    json_read(c, 1);
+  }
+#endif
+  
+  // Records the array or object that starts at the current position
+  static uint32_t json_span_begin(JsonContext* c) {
+    JsonSpans* spans = c->spans;
+    if (!spans) return JSON_SPAN_NONE;
+    
+    if (spans->count >= spans->capacity) {
+      uint32_t capacity = (spans->capacity) ? spans->capacity * 2 : 64;
+      JsonSpan* data = (JsonSpan*)JSON_REALLOC(spans->data, capacity * sizeof(JsonSpan));
+      if (!data) {
+        c->is_parsing = 0;
+        return JSON_SPAN_NONE;
+      }
+      
+      spans->data = data;
+      spans->capacity = capacity;
+    }
+    
+    JsonSpan* span = &spans->data[spans->count];
+    span->start = c->span_base + c->curr;
+    span->end = span->start;
+    span->parent = c->span_parent;
+    span->index = c->span_index;
+    
+    c->span_parent = spans->count;
+    return spans->count++;
+  }
+  
+  static void json_span_end(JsonContext* c, uint32_t span) {
+    if (span == JSON_SPAN_NONE) return;
+    
+    c->spans->data[span].end = c->span_base + c->curr;
+    c->span_parent = c->spans->data[span].parent;
+  }
+  
+  static void json_parse_value(JsonContext* c, JsonValue* value) {
+#ifdef JSON_ENABLE_STATS
+    if (++c->depth > c->max_depth) c->max_depth = c->depth;
+#endif
+    
+    // Element storage isn't zeroed, and a value that fails to parse still has to be freed
+    value->type = JSON_NULL;
+    value->flags = 0;
+    
+    json_char peek = json_peek(c);
+    
+#ifdef JSON_ALLOW_COMMENTS
+    // Keep parsing comments
+    while (peek == JSTR('#')) {
+      json_parse_comment(c);
+      peek = json_peek(c);
+    }
+#endif
+    
+    switch (peek) {
+      case JSTR('{'): {
+        uint32_t span = json_span_begin(c);
+        
+        value->type = JSON_OBJECT;
+        value->object_value = json_parse_object(c);
+        if (c->in_situ) value->flags |= JSON_VALUE_BORROWED;
+        
+        json_span_end(c, span);
+        break;
+      }
+      
+      case JSTR('['): {
+        uint32_t span = json_span_begin(c);
+        
+        json_bool is_number_array = 0;
+        if (c->flags & JSON_PARSE_NUMBER_ARRAYS) {
+          JSON_STATS_BEGIN(start);
+          is_number_array = json_parse_number_array(c, value);
+          JSON_STATS_END(start, number_time);
+        }
+        
+        if (!is_number_array) {
+          value->type = JSON_ARRAY;
+          value->array_value = json_parse_array(c);
+        }
+        
+        json_span_end(c, span);
+        break;
+      }
+      
+      case JSTR('"'): {
+        JSON_STATS_BEGIN(start);
+        value->type = JSON_STRING;
+        value->string_value = json_parse_string(c);
+        if (c->in_situ) value->flags |= JSON_VALUE_BORROWED;
+        JSON_STATS_END(start, string_time);
+        break;
+      }
+      
+      default: {
+        if (c->buffer[0] == JSTR('-') ||
+            isdigit(c->buffer[0])) {
+          JSON_STATS_BEGIN(start);
+          json_parse_number(c, value);
+          JSON_STATS_END(start, number_time);
+        } else {
+          uint64_t word_start = c->curr;
+          uint32_t word_length = 0;
+          
+          // A word can end the input, e.g. a document that is just true
+          while (c->curr < c->len) {
+            json_read(c, 1);
+            if (c->buffer[0] >= JSTR('a') && c->buffer[0] <= JSTR('z')) {
+              ++word_length;
+            } else {
+              break;
+            }
+          }
+          
+          c->curr = word_start;
+          json_read(c, word_length);
+          
+          if (json_strcmp(c->buffer, JSTR("true")) == 0) {
+            value->type = JSON_BOOL;
+            value->bool_value = 1;
+          } else if (json_strcmp(c->buffer, JSTR("false")) == 0) {
+            value->type = JSON_BOOL;
+            value->bool_value = 0;
+          } else if (json_strcmp(c->buffer, JSTR("null")) == 0) {
+            value->type = JSON_NULL;
+          } else {
+            json_printf(JSTR("Unknown token '%s'\n"), c->buffer);
+            c->is_parsing = 0;
+          }
+        }
+      }
+    }
+    
+#ifdef JSON_ENABLE_STATS
+    --c->depth;
+    if (json_stats && c->is_parsing) ++json_stats->values[value->type];
+#endif
+  }
+  
+  JsonValue json_parse_from_file(const char* path) {
+    FILE* file = fopen(path, JSON_READ_MODE);
+    
+    if (!file) {
+      printf("Could not open file '%s'\n", path);
+      
+      JsonValue dummy  = {};
+      return dummy;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    uint64_t size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    
+    json_char* json_text = (json_char*)JSON_MALLOC(((uint32_t)size + 1) * sizeof(json_char));
+    json_text[0] = JSTR('\0');
+    
+    json_char* cursor = json_text;
+    while (!feof(file)) {
+      json_fgets(cursor, (int)size, file);
+      cursor = json_text + json_strlen(json_text);
+    }
+    
+    fclose(file);
+    
+    JsonValue value = json_parse(json_text);
+    
+    JSON_FREE(json_text);
+    
+    return value;
+  }
+  
+  static JsonValue json_parse_context(const json_char* json_text, uint32_t flags, JsonParser* parser, json_bool in_situ, json_bool* ok);
+  
+  JsonValue json_parse(const json_char* json_text) {
+    return json_parse_ex(json_text, 0);
+  }
+  
+  JsonValue json_parse_ex(const json_char* json_text, uint32_t flags) {
+    return json_parse_context(json_text, flags, NULL, 0, NULL);
+  }
+  
+  JsonValue json_parse_in_situ(json_char* json_text, uint32_t flags) {
+    return json_parse_context(json_text, flags, NULL, 1, NULL);
+  }
+  
+  static JsonValue json_parse_context(const json_char* json_text, uint32_t flags, JsonParser* parser, json_bool in_situ, json_bool* ok) {
+    JsonContext c  = {};
+    c.is_parsing = 1;
+    c.flags = flags;
+    c.parser = parser;
+    
+    // @TODO: right now we're ignoring the byte-order mark
+    // Can we get away with that?
+    const int BOM_CHAR = 65279;
+    if (JSON_CHAR_MAX >= BOM_CHAR && json_text[0] == BOM_CHAR) {
+      ++json_text;
+    }
+    
+    c.text = json_text;
+    c.len = json_strlen(c.text);
+    
+    // The caller handed in writable text
+    if (in_situ) c.in_situ = (json_char*)json_text;
+    
+#ifdef JSON_ENABLE_STATS
+    // Whatever isn't spent on numbers or strings is spent on structure
+    JSON_STATS_BEGIN(start);
+    uint64_t leaf_time = (json_stats) ? json_stats->number_time + json_stats->string_time : 0;
+#endif
+    
+    JsonValue value  = {};
+    json_parse_value(&c, &value);
+    if (ok) *ok = c.is_parsing;
+    
+#ifdef JSON_ENABLE_STATS
+    if (json_stats) {
+      uint64_t total = json_stats_now() - start;
+      leaf_time = json_stats->number_time + json_stats->string_time - leaf_time;
+      
+      ++json_stats->documents;
+      json_stats->bytes_scanned += c.curr * sizeof(json_char);
+      json_stats->structural_time += (total > leaf_time) ? total - leaf_time : 0;
+      if (c.max_depth > json_stats->max_depth) json_stats->max_depth = c.max_depth;
+    }
+#endif
+    
+    return value;
+  }
+  
+  JsonValue json_parse_with(const json_char* json_text, uint32_t flags, const JsonAllocator* allocator) {
+    const JsonAllocator* previous = json_set_allocator(allocator);
+    JsonValue value = json_parse_ex(json_text, flags);
+    json_set_allocator(previous);
+    
+    return value;
+  }
+  
+  // JsonHashCache entries are keyed by address, one from before storage was released may be for an address that
+  // was reused since. Only counted while a cache holds entries, releasing storage is otherwise left alone
+  static uint32_t json_hash_caches = 0;
+  static uint64_t json_storage_epoch = 0;
+  
+#ifdef _WIN32
+  static uint32_t json_hash_caches_load(void) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)&json_hash_caches, 0, 0); }
+  static void json_hash_caches_add(LONG count) { InterlockedExchangeAdd((volatile LONG*)&json_hash_caches, count); }
+  static uint64_t json_storage_epoch_load(void) { return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)&json_storage_epoch, 0, 0); }
+  static void json_storage_epoch_bump(void) { InterlockedIncrement64((volatile LONG64*)&json_storage_epoch); }
+#else
+  static uint32_t json_hash_caches_load(void) { return __atomic_load_n(&json_hash_caches, __ATOMIC_RELAXED); }
+  static void json_hash_caches_add(int32_t count) { __atomic_add_fetch(&json_hash_caches, (uint32_t)count, __ATOMIC_RELAXED); }
+  static uint64_t json_storage_epoch_load(void) { return __atomic_load_n(&json_storage_epoch, __ATOMIC_ACQUIRE); }
+  static void json_storage_epoch_bump(void) { __atomic_add_fetch(&json_storage_epoch, 1, __ATOMIC_RELEASE); }
+#endif
+  
+  // Called before array/object storage is freed or an arena is reused
+  static inline void json_storage_released(void) {
+    if (json_hash_caches_load() != 0) json_storage_epoch_bump();
+  }
+  
+  // Reusable parser
+  
+  // Every arena allocation is preceded by its size so it can be reallocated
+  typedef struct {
+    uint64_t size;
+  } JsonArenaHeader;
+  
+  static inline uint64_t json_arena_align(uint64_t size) {
+    return (size + 15) & ~(uint64_t)15;
+  }
+  
+  static inline uint8_t* json_arena_data(JsonArenaChunk* chunk) {
+    return (uint8_t*)chunk + json_arena_align(sizeof(JsonArenaChunk));
+  }
+  
+  static void* json_arena_allocate(void* user, size_t size) {
+    JsonParser* p = (JsonParser*)user;
+    uint64_t needed = json_arena_align(sizeof(JsonArenaHeader)) + json_arena_align(size);
+    
+    // Move on to the next chunk that fits, chunks are reused after a reset
+    JsonArenaChunk* chunk = p->current;
+    while (chunk && chunk->used + needed > chunk->size) {
+      chunk = chunk->next;
+      if (chunk) chunk->used = 0;
+    }
+    
+    if (!chunk) {
+      uint64_t chunk_size = (needed > JSON_PARSER_CHUNK_SIZE) ? needed : JSON_PARSER_CHUNK_SIZE;
+      chunk = (JsonArenaChunk*)JSON_MALLOC((size_t)(json_arena_align(sizeof(JsonArenaChunk)) + chunk_size));
+      if (!chunk) return NULL;
+      
+      chunk->size = chunk_size;
+      chunk->used = 0;
+      
+      // Keep the list in allocation order so a reset walks the same chunks again
+      if (p->current) {
+        chunk->next = p->current->next;
+        p->current->next = chunk;
+      } else {
+        chunk->next = NULL;
+        p->chunks = chunk;
+      }
+    }
+    
+    p->current = chunk;
+    p->last = chunk->used;
+    
+    JsonArenaHeader* header = (JsonArenaHeader*)(json_arena_data(chunk) + chunk->used);
+    header->size = size;
+    chunk->used += needed;
+    
+    return (uint8_t*)header + json_arena_align(sizeof(JsonArenaHeader));
+  }
+  
+  static json_bool json_arena_is_last(JsonParser* p, void* ptr) {
+    if (!p->current) return 0;
+    
+    uint8_t* last = json_arena_data(p->current) + p->last + json_arena_align(sizeof(JsonArenaHeader));
+    return (uint8_t*)ptr == last && p->last < p->current->used;
+  }
+  
+  static void* json_arena_reallocate(void* user, void* ptr, size_t size) {
+    JsonParser* p = (JsonParser*)user;
+    if (!ptr) return json_arena_allocate(user, size);
+    
+    JsonArenaHeader* header = (JsonArenaHeader*)((uint8_t*)ptr - json_arena_align(sizeof(JsonArenaHeader)));
+    
+    // Grow in place if it's the last allocation, which is the common case for a growing array
+    if (json_arena_is_last(p, ptr)) {
+      uint64_t needed = json_arena_align(sizeof(JsonArenaHeader)) + json_arena_align(size);
+      if (p->last + needed <= p->current->size) {
+        header->size = size;
+        p->current->used = p->last + needed;
+        return ptr;
+      }
+    }
+    
+    void* moved = json_arena_allocate(user, size);
+    if (moved) memcpy(moved, ptr, (size_t)((header->size < size) ? header->size : size));
+    
+    return moved;
+  }
+  
+  static void json_arena_deallocate(void* user, void* ptr) {
+    JsonParser* p = (JsonParser*)user;
+    
+    // Only the last allocation is given back, everything else lives until json_parser_reset()
+    if (ptr && json_arena_is_last(p, ptr)) {
+      p->current->used = p->last;
+    }
+  }
+  
+  void json_parser_init(JsonParser* parser) {
+    memset(parser, 0, sizeof(JsonParser));
+    
+    parser->allocator.allocate = json_arena_allocate;
+    parser->allocator.reallocate = json_arena_reallocate;
+    parser->allocator.deallocate = json_arena_deallocate;
+    parser->allocator.user = parser;
+  }
+  
+  void json_parser_free(JsonParser* parser) {
+    json_storage_released();
+    
+    JsonArenaChunk* chunk = parser->chunks;
+    while (chunk) {
+      JsonArenaChunk* next = chunk->next;
+      JSON_FREE(chunk);
+      chunk = next;
+    }
+    
+    for (uint32_t i = 0; i < parser->key_capacity; ++i) {
+      if (parser->keys[i].key) JSON_FREE(parser->keys[i].key);
+    }
+    if (parser->keys) JSON_FREE(parser->keys);
+    
+    json_parser_init(parser);
+  }
+  
+  void json_parser_reset(JsonParser* parser) {
+    json_storage_released();
+    
+    parser->current = parser->chunks;
+    parser->last = 0;
+    if (parser->current) parser->current->used = 0;
+  }
+  
+  static json_bool json_parser_grow_keys(JsonParser* p) {
+    uint32_t capacity = (p->key_capacity) ? p->key_capacity * 2 : 256;
+    
+    JsonInternedKey* keys = (JsonInternedKey*)JSON_MALLOC(capacity * sizeof(JsonInternedKey));
+    if (!keys) return 0;
+    memset(keys, 0, capacity * sizeof(JsonInternedKey));
+    
+    for (uint32_t i = 0; i < p->key_capacity; ++i) {
+      if (!p->keys[i].key) continue;
+      
+      uint32_t slot = p->keys[i].hash & (capacity - 1);
+      while (keys[slot].key) slot = (slot + 1) & (capacity - 1);
+      keys[slot] = p->keys[i];
+    }
+    
+    if (p->keys) JSON_FREE(p->keys);
+    p->keys = keys;
+    p->key_capacity = capacity;
+    
+    return 1;
+  }
+  
+  // Swaps a freshly parsed key for the interned copy, so repeated keys cost no arena space
+  static void json_parser_intern(JsonParser* p, JsonObject* field) {
+    // @HARDCODED
+    const uint32_t MAX_INTERNED_LENGTH = 64;
+    
+    uint32_t length = (uint32_t)json_strlen(field->key);
+    if (length > MAX_INTERNED_LENGTH) return;
+    
+    if (p->key_capacity > 0) {
+      uint32_t slot = field->key_hash & (p->key_capacity - 1);
+      for (; p->keys[slot].key; slot = (slot + 1) & (p->key_capacity - 1)) {
+        JsonInternedKey* k = &p->keys[slot];
+        if (k->hash == field->key_hash && k->length == length &&
+            memcmp(k->key, field->key, length * sizeof(json_char)) == 0) {
+          json_mem_free(field->key);
+          field->key = k->key;
+          return;
+        }
+      }
+    }
+    
+    if (p->key_count >= JSON_PARSER_MAX_KEYS) return;
+    if ((p->key_count + 1) * 2 > p->key_capacity && !json_parser_grow_keys(p)) return;
+    
+    json_char* key = (json_char*)JSON_MALLOC((length + 1) * sizeof(json_char));
+    if (!key) return;
+    memcpy(key, field->key, (length + 1) * sizeof(json_char));
+    
+    uint32_t slot = field->key_hash & (p->key_capacity - 1);
+    while (p->keys[slot].key) slot = (slot + 1) & (p->key_capacity - 1);
+    
+    p->keys[slot].key = key;
+    p->keys[slot].hash = field->key_hash;
+    p->keys[slot].length = length;
+    ++p->key_count;
+    
+    json_mem_free(field->key);
+    field->key = key;
+  }
+  
+  JsonValue json_parser_parse(JsonParser* parser, const json_char* json_text, uint32_t flags) {
+    const JsonAllocator* previous = json_set_allocator(&parser->allocator);
+    JsonValue value = json_parse_context(json_text, flags, parser, 0, NULL);
+    json_set_allocator(previous);
+    
+    return value;
+  }
+  
+  JsonValue json_parser_parse_in_situ(JsonParser* parser, json_char* json_text, uint32_t flags) {
+    const JsonAllocator* previous = json_set_allocator(&parser->allocator);
+    JsonValue value = json_parse_context(json_text, flags, parser, 1, NULL);
+    json_set_allocator(previous);
+    
+    return value;
+  }
+  
+  // Streaming
+  
+#ifndef JSON_NO_THREADS
+  typedef void (*JsonThreadProc)(void* arg);
+  
+#ifdef _WIN32
+  typedef struct {
+    HANDLE handle;
+    JsonThreadProc proc;
+    void* arg;
+  } JsonThread;
+  
+  typedef CRITICAL_SECTION JsonMutex;
+  typedef CONDITION_VARIABLE JsonCond;
+  
+  static DWORD WINAPI json_thread_main(LPVOID param) {
+    JsonThread* thread = (JsonThread*)param;
+    thread->proc(thread->arg);
+    return 0;
+  }
+  
+  static json_bool json_thread_start(JsonThread* thread, JsonThreadProc proc, void* arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, json_thread_main, thread, 0, NULL);
+    return thread->handle != NULL;
+  }
+  
+  static void json_thread_join(JsonThread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+  }
+  
+  static void json_mutex_init(JsonMutex* mutex) { InitializeCriticalSection(mutex); }
+  static void json_mutex_destroy(JsonMutex* mutex) { DeleteCriticalSection(mutex); }
+  static void json_mutex_lock(JsonMutex* mutex) { EnterCriticalSection(mutex); }
+  static void json_mutex_unlock(JsonMutex* mutex) { LeaveCriticalSection(mutex); }
+  
+  static void json_cond_init(JsonCond* cond) { InitializeConditionVariable(cond); }
+  static void json_cond_destroy(JsonCond* cond) { (void)cond; }
+  static void json_cond_wait(JsonCond* cond, JsonMutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+  static void json_cond_broadcast(JsonCond* cond) { WakeAllConditionVariable(cond); }
+#else
+  typedef struct {
+    pthread_t handle;
+    JsonThreadProc proc;
+    void* arg;
+  } JsonThread;
+  
+  typedef pthread_mutex_t JsonMutex;
+  typedef pthread_cond_t JsonCond;
+  
+  static void* json_thread_main(void* param) {
+    JsonThread* thread = (JsonThread*)param;
+    thread->proc(thread->arg);
+    return NULL;
+  }
+  
+  static json_bool json_thread_start(JsonThread* thread, JsonThreadProc proc, void* arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, json_thread_main, thread) == 0;
+  }
+  
+  static void json_thread_join(JsonThread* thread) {
+    pthread_join(thread->handle, NULL);
+  }
+  
+  static void json_mutex_init(JsonMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+  static void json_mutex_destroy(JsonMutex* mutex) { pthread_mutex_destroy(mutex); }
+  static void json_mutex_lock(JsonMutex* mutex) { pthread_mutex_lock(mutex); }
+  static void json_mutex_unlock(JsonMutex* mutex) { pthread_mutex_unlock(mutex); }
+  
+  static void json_cond_init(JsonCond* cond) { pthread_cond_init(cond, NULL); }
+  static void json_cond_destroy(JsonCond* cond) { pthread_cond_destroy(cond); }
+  static void json_cond_wait(JsonCond* cond, JsonMutex* mutex) { pthread_cond_wait(cond, mutex); }
+  static void json_cond_broadcast(JsonCond* cond) { pthread_cond_broadcast(cond); }
+#endif
+  
+  // Two blocks the reader thread fills while the other one is being parsed
+  typedef struct {
+    JsonThread thread;
+    JsonMutex mutex;
+    JsonCond cond;
+    
+    JsonReadCallback read;
+    void* user;
+    
+    uint8_t* blocks[2];
+    int64_t sizes[2];
+    json_bool filled[2];
+    uint32_t next;
+    
+    json_bool stop;
+  } JsonStreamPipe;
+  
+  static void json_stream_pipe_run(void* arg) {
+    JsonStreamPipe* pipe = (JsonStreamPipe*)arg;
+    
+    for (uint32_t slot = 0;; slot ^= 1) {
+      json_mutex_lock(&pipe->mutex);
+      while (pipe->filled[slot] && !pipe->stop) json_cond_wait(&pipe->cond, &pipe->mutex);
+      json_bool stop = pipe->stop;
+      json_mutex_unlock(&pipe->mutex);
+      
+      if (stop) break;
+      
+      int64_t size = pipe->read(pipe->user, pipe->blocks[slot], JSON_STREAM_BLOCK_SIZE);
+      
+      json_mutex_lock(&pipe->mutex);
+      pipe->sizes[slot] = size;
+      pipe->filled[slot] = 1;
+      json_cond_broadcast(&pipe->cond);
+      json_mutex_unlock(&pipe->mutex);
+      
+      if (size <= 0) break;
+    }
+  }
+  
+  static JsonStreamPipe* json_stream_pipe_start(JsonReadCallback read, void* user) {
+    JsonStreamPipe* pipe = (JsonStreamPipe*)JSON_MALLOC(sizeof(JsonStreamPipe));
+    if (!pipe) return NULL;
+    memset(pipe, 0, sizeof(JsonStreamPipe));
+    
+    pipe->read = read;
+    pipe->user = user;
+    pipe->blocks[0] = (uint8_t*)JSON_MALLOC(JSON_STREAM_BLOCK_SIZE);
+    pipe->blocks[1] = (uint8_t*)JSON_MALLOC(JSON_STREAM_BLOCK_SIZE);
+    
+    if (pipe->blocks[0] && pipe->blocks[1]) {
+      json_mutex_init(&pipe->mutex);
+      json_cond_init(&pipe->cond);
+      if (json_thread_start(&pipe->thread, json_stream_pipe_run, pipe)) return pipe;
+      
+      json_cond_destroy(&pipe->cond);
+      json_mutex_destroy(&pipe->mutex);
+    }
+    
+    if (pipe->blocks[0]) JSON_FREE(pipe->blocks[0]);
+    if (pipe->blocks[1]) JSON_FREE(pipe->blocks[1]);
+    JSON_FREE(pipe);
+    return NULL;
+  }
+  
+  // Copies the next block out, same results as read()
+  static int64_t json_stream_pipe_take(JsonStreamPipe* pipe, uint8_t* out) {
+    uint32_t slot = pipe->next;
+    
+    json_mutex_lock(&pipe->mutex);
+    while (!pipe->filled[slot]) json_cond_wait(&pipe->cond, &pipe->mutex);
+    int64_t size = pipe->sizes[slot];
+    json_mutex_unlock(&pipe->mutex);
+    
+    // The reader has stopped after the last block, leave it filled so we keep returning it
+    if (size <= 0) return size;
+    
+    memcpy(out, pipe->blocks[slot], (size_t)size);
+    
+    json_mutex_lock(&pipe->mutex);
+    pipe->filled[slot] = 0;
+    json_cond_broadcast(&pipe->cond);
+    json_mutex_unlock(&pipe->mutex);
+    
+    pipe->next = slot ^ 1;
+    return size;
+  }
+  
+  static void json_stream_pipe_stop(JsonStreamPipe* pipe) {
+    json_mutex_lock(&pipe->mutex);
+    pipe->stop = 1;
+    json_cond_broadcast(&pipe->cond);
+    json_mutex_unlock(&pipe->mutex);
+    
+    // Waits for a read() that's still running
+    json_thread_join(&pipe->thread);
+    
+    json_cond_destroy(&pipe->cond);
+    json_mutex_destroy(&pipe->mutex);
+    JSON_FREE(pipe->blocks[0]);
+    JSON_FREE(pipe->blocks[1]);
+    JSON_FREE(pipe);
+  }
+#endif
+  
+#ifndef JSON_USE_SINGLE_BYTE
+  // Converts UTF-8 into a growable buffer of json_char, never more code units than bytes
+  static json_char* json_utf8_to_text(const uint8_t* data, uint64_t size, json_char** text, uint64_t* capacity) {
+    if (size + 1 > *capacity) {
+      uint64_t new_capacity = (*capacity) ? *capacity : 256;
+      while (new_capacity < size + 1) new_capacity *= 2;
+      
+      json_char* new_text = (json_char*)JSON_REALLOC(*text, (size_t)new_capacity * sizeof(json_char));
+      if (!new_text) return NULL;
+      
+      *text = new_text;
+      *capacity = new_capacity;
+    }
+    
+    json_char* out = *text;
+    uint64_t length = 0;
+    for (uint64_t i = 0; i < size;) {
+      uint32_t cp = json_utf8_decode(data, size, &i);
+      
+      if (sizeof(json_char) == 2 && cp > 0xFFFF) {
+        cp -= 0x10000;
+        out[length++] = (json_char)(0xD800 + (cp >> 10));
+        out[length++] = (json_char)(0xDC00 + (cp & 0x3FF));
+      } else {
+        out[length++] = (json_char)cp;
+      }
+    }
+    out[length] = JSTR('\0');
+    
+    return out;
+  }
+#endif
+  
+  // Window over the input that holds at least the value being parsed
+  typedef struct {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+    
+    // Everything before start has been parsed, scan is how far the search for the end of the value got
+    uint64_t start;
+    uint64_t scan;
+    
+    uint32_t depth;
+    json_bool in_string;
+    json_bool escape;
+    json_bool scalar;
+    
+    json_bool eof;
+    json_bool failed;
+    
+    JsonReadCallback read;
+    void* user;
+    
+#ifndef JSON_NO_THREADS
+    JsonStreamPipe* pipe;
+#endif
+    
+#ifndef JSON_USE_SINGLE_BYTE
+    // The value converted from UTF-8
+    json_char* text;
+    uint64_t text_capacity;
+#endif
+  } JsonStream;
+  
+  // Drops the parsed bytes and reads the next block, returns 0 at the end of the input
+  static json_bool json_stream_refill(JsonStream* s) {
+    if (s->eof) return 0;
+    
+    if (s->start > 0) {
+      memmove(s->data, s->data + s->start, (size_t)(s->size - s->start));
+      s->size -= s->start;
+      s->scan -= s->start;
+      s->start = 0;
+    }
+    
+    // Room for a block and the terminator that's written behind a value
+    if (s->size + JSON_STREAM_BLOCK_SIZE + 1 > s->capacity) {
+      uint64_t capacity = (s->capacity) ? s->capacity : JSON_STREAM_BLOCK_SIZE;
+      while (capacity < s->size + JSON_STREAM_BLOCK_SIZE + 1) capacity *= 2;
+      
+      uint8_t* data = (uint8_t*)JSON_REALLOC(s->data, (size_t)capacity);
+      if (!data) {
+        s->eof = s->failed = 1;
+        return 0;
+      }
+      
+      s->data = data;
+      s->capacity = capacity;
+    }
+    
+    int64_t size;
+#ifndef JSON_NO_THREADS
+    if (s->pipe) size = json_stream_pipe_take(s->pipe, s->data + s->size);
+    else
+#endif
+    size = s->read(s->user, s->data + s->size, JSON_STREAM_BLOCK_SIZE);
+    
+    if (size <= 0) {
+      if (size < 0) {
+        json_printf(JSTR("Failed to read the JSON stream\n"));
+        s->failed = 1;
+      }
+      
+      s->eof = 1;
+      return 0;
+    }
+    
+    s->size += (uint64_t)size;
+    return 1;
+  }
+  
+  // Skips whitespace, and commas when in between the elements of the outer array
+  static json_bool json_stream_skip(JsonStream* s, json_bool commas) {
+    for (;;) {
+      while (s->start < s->size) {
+        uint8_t ch = s->data[s->start];
+        if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r' && !(commas && ch == ',')) return 1;
+        ++s->start;
+      }
+      
+      if (!json_stream_refill(s)) return 0;
+    }
+  }
+  
+  // Looks for the end of the value at start by matching quotes and brackets, returns 0 if more input is needed
+  static json_bool json_stream_scan(JsonStream* s, uint64_t* end) {
+    const uint8_t* data = s->data;
+    
+    uint64_t i = s->scan;
+    for (; i < s->size; ++i) {
+      uint8_t ch = data[i];
+      
+      if (s->in_string) {
+        if (s->escape) s->escape = 0;
+        else if (ch == '\\') s->escape = 1;
+        else if (ch == '"') {
+          s->in_string = 0;
+          if (s->depth == 0) {
+            *end = i + 1;
+            return 1;
+          }
+        }
+      } else if (s->scalar) {
+        if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == ',' ||
+            ch == '[' || ch == ']' || ch == '{' || ch == '}' || ch == '"') {
+          *end = i;
+          return 1;
+        }
+      } else if (ch == '"') {
+        s->in_string = 1;
+      } else if (ch == '[' || ch == '{') {
+        ++s->depth;
+      } else if (ch == ']' || ch == '}') {
+        if (--s->depth == 0) {
+          *end = i + 1;
+          return 1;
+        }
+      }
+    }
+    
+    s->scan = i;
+    return 0;
+  }
+  
+  // Parses the value that ends at end, ok is 0 if it doesn't parse
+  static JsonValue json_stream_parse(JsonStream* s, JsonParser* parser, uint64_t end, uint32_t flags, json_bool* ok) {
+    const uint8_t* value = s->data + s->start;
+    const JsonAllocator* previous = json_set_allocator(&parser->allocator);
+    
+#ifdef JSON_USE_SINGLE_BYTE
+    // Terminate the value in place for the in situ parse, there's always room for it
+    uint8_t next = s->data[end];
+    s->data[end] = '\0';
+    
+    JsonValue json = json_parse_context((json_char*)value, flags, parser, 1, ok);
+    
+    s->data[end] = next;
+#else
+    JsonValue json = {};
+    if (json_utf8_to_text(value, end - s->start, &s->text, &s->text_capacity)) {
+      json = json_parse_context(s->text, flags, parser, 1, ok);
+    } else {
+      s->eof = s->failed = 1;
+    }
+#endif
+    
+    json_set_allocator(previous);
+    
+    s->start = end;
+    return json;
+  }
+  
+  uint64_t json_parse_stream(JsonReadCallback read, void* read_user, uint32_t flags, JsonStreamCallback callback, void* user, json_bool* ok) {
+    if (ok) *ok = 0;
+    if (!read || !callback) return 0;
+    
+    JsonStream s = {};
+    s.read = read;
+    s.user = read_user;
+    
+#ifndef JSON_NO_THREADS
+    if (flags & JSON_STREAM_THREADED) s.pipe = json_stream_pipe_start(read, read_user);
+#endif
+    
+    JsonParser parser;
+    json_parser_init(&parser);
+    
+    json_bool elements = (flags & JSON_STREAM_ELEMENTS) != 0;
+    json_bool in_array = 0;
+    // The window is moved and reused, raw numbers pointing into it wouldn't survive the callback
+    uint32_t parse_flags = flags & ~(uint32_t)(JSON_STREAM_ELEMENTS | JSON_STREAM_THREADED | JSON_PARSE_LAZY_NUMBERS);
+    
+    // UTF-8 byte-order mark, reads can be shorter than that
+    while (s.size < 3 && json_stream_refill(&s)) {}
+    if (s.size >= 3 && memcmp(s.data, "\xEF\xBB\xBF", 3) == 0) s.start = 3;
+    
+    uint64_t count = 0;
+    json_bool closed = 0;
+    json_bool stopped = 0;
+    while (json_stream_skip(&s, in_array)) {
+      uint8_t ch = s.data[s.start];
+      
+      if (elements && !in_array) {
+        if (ch != '[') {
+          json_printf(JSTR("JSON stream must be an array to stream its elements\n"));
+          s.failed = 1;
+          break;
+        }
+        
+        in_array = 1;
+        ++s.start;
+        continue;
+      }
+      
+      if (in_array && ch == ']') {
+        closed = 1;
+        break;
+      }
+      
+      s.depth = 0;
+      s.in_string = s.escape = 0;
+      s.scalar = (ch != '[' && ch != '{' && ch != '"');
+      s.scan = (s.scalar) ? s.start + 1 : s.start;
+      
+      // Only a scalar can end with the input, anything else was cut off
+      uint64_t end;
+      json_bool found = 1;
+      while (!json_stream_scan(&s, &end)) {
+        if (!json_stream_refill(&s)) {
+          end = s.size;
+          found = s.scalar && !s.failed;
+          break;
+        }
+      }
+      
+      if (!found) {
+        if (!s.failed) json_printf(JSTR("JSON stream ends in the middle of a value\n"));
+        s.failed = 1;
+        break;
+      }
+      
+      json_bool parsed = 0;
+      JsonValue json = json_stream_parse(&s, &parser, end, parse_flags, &parsed);
+      if (s.failed || !parsed) {
+        s.failed = 1;
+        break;
+      }
+      
+      ++count;
+      stopped = !callback(user, &json);
+      json_parser_reset(&parser);
+      
+      if (stopped) break;
+    }
+    
+#ifndef JSON_NO_THREADS
+    if (s.pipe) json_stream_pipe_stop(s.pipe);
+#endif
+    
+    // The callback stopping early isn't an error, running out of input before the array is closed is
+    if (elements && !closed && !stopped && !s.failed) {
+      json_printf(JSTR("JSON stream ends before the array is closed\n"));
+      s.failed = 1;
+    }
+    
+    json_parser_free(&parser);
+    if (s.data) JSON_FREE(s.data);
+#ifndef JSON_USE_SINGLE_BYTE
+    if (s.text) JSON_FREE(s.text);
+#endif
+    
+    if (ok) *ok = !s.failed;
+    return count;
+  }
+  
+  static int64_t json_stream_read_file(void* user, void* buffer, uint64_t size) {
+    FILE* file = (FILE*)user;
+    
+    size_t read = fread(buffer, 1, (size_t)size, file);
+    if (read == 0 && ferror(file)) return -1;
+    
+    return (int64_t)read;
+  }
+  
+  uint64_t json_parse_stream_file(const char* path, uint32_t flags, JsonStreamCallback callback, void* user, json_bool* ok) {
+    if (ok) *ok = 0;
+    FILE* file = fopen(path, "rb");
+    
+    if (!file) {
+      printf("Could not open file '%s'\n", path);
+      return 0;
+    }
+    
+    uint64_t count = json_parse_stream(json_stream_read_file, file, flags, callback, user, ok);
+    
+    fclose(file);
+    return count;
+  }
+  
+  // Batch loading
+  
+  // Reads a whole file into a reused buffer with as few calls as possible, the size isn't looked up first
+  static json_bool json_read_file(const char* path, uint8_t** data, uint64_t* capacity, uint64_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return 0;
+    
+    *size = 0;
+    for (;;) {
+      // Room for the rest of a 4K page and the terminator
+      if (*size + 4096 + 1 > *capacity) {
+        uint64_t new_capacity = (*capacity) ? *capacity * 2 : 65536;
+        while (new_capacity < *size + 4096 + 1) new_capacity *= 2;
+        
+        uint8_t* new_data = (uint8_t*)JSON_REALLOC(*data, (size_t)new_capacity);
+        if (!new_data) {
+          fclose(file);
+          return 0;
+        }
+        
+        *data = new_data;
+        *capacity = new_capacity;
+      }
+      
+      size_t read = fread(*data + *size, 1, (size_t)(*capacity - *size - 1), file);
+      *size += read;
+      
+      if (read == 0) break;
+    }
+    
+    json_bool ok = !ferror(file);
+    fclose(file);
+    
+    (*data)[*size] = '\0';
+    return ok;
+  }
+  
+  typedef struct {
+    const char* const* paths;
+    JsonFileResult* results;
+    uint32_t count;
+    uint32_t flags;
+    
+    // Next path to load, and how many files parsed
+    uint32_t next;
+    uint32_t parsed;
+    
+#ifndef JSON_NO_THREADS
+    JsonMutex mutex;
+#endif
+  } JsonBatch;
+  
+  static void json_batch_run(void* arg) {
+    JsonBatch* batch = (JsonBatch*)arg;
+    
+    // Each worker keeps its buffers for all the files it loads
+    uint8_t* data = NULL;
+    uint64_t capacity = 0;
+#ifndef JSON_USE_SINGLE_BYTE
+    json_char* text = NULL;
+    uint64_t text_capacity = 0;
+#endif
+    
+    uint32_t parsed = 0;
+    for (;;) {
+#ifndef JSON_NO_THREADS
+      json_mutex_lock(&batch->mutex);
+#endif
+      uint32_t index = batch->next;
+      if (index < batch->count) ++batch->next;
+#ifndef JSON_NO_THREADS
+      json_mutex_unlock(&batch->mutex);
+#endif
+      
+      if (index >= batch->count) break;
+      
+      JsonFileResult* result = &batch->results[index];
+      memset(result, 0, sizeof(JsonFileResult));
+      
+      uint64_t size;
+      if (!json_read_file(batch->paths[index], &data, &capacity, &size)) continue;
+      
+      // UTF-8 byte-order mark
+      uint64_t start = (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+      
+#ifdef JSON_USE_SINGLE_BYTE
+      result->value = json_parse_context((const json_char*)(data + start), batch->flags, NULL, 0, &result->parsed);
+#else
+      if (!json_utf8_to_text(data + start, size - start, &text, &text_capacity)) continue;
+      result->value = json_parse_context(text, batch->flags, NULL, 0, &result->parsed);
+#endif
+      
+      result->loaded = 1;
+      if (result->parsed) ++parsed;
+    }
+    
+    if (data) JSON_FREE(data);
+#ifndef JSON_USE_SINGLE_BYTE
+    if (text) JSON_FREE(text);
+#endif
+    
+#ifndef JSON_NO_THREADS
+    json_mutex_lock(&batch->mutex);
+#endif
+    batch->parsed += parsed;
+#ifndef JSON_NO_THREADS
+    json_mutex_unlock(&batch->mutex);
+#endif
+  }
+  
+#ifndef JSON_NO_THREADS
+  static uint32_t json_cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif
+  }
+#endif
+  
+  uint32_t json_parse_files(const char* const* paths, uint32_t count, uint32_t flags, JsonFileResult* results, uint32_t threads) {
+    if (!paths || !results || count == 0) return 0;
+    
+    JsonBatch batch = {};
+    batch.paths = paths;
+    batch.results = results;
+    batch.count = count;
+    
+    // The text is gone once a file is parsed
+    batch.flags = flags & ~(uint32_t)JSON_PARSE_LAZY_NUMBERS;
+    
+    // Workers start out without an allocator, so the calling thread doesn't use its own either
+    const JsonAllocator* previous = json_set_allocator(NULL);
+    
+#ifdef JSON_NO_THREADS
+    (void)threads;
+    json_batch_run(&batch);
+#else
+    if (threads == 0) threads = json_cpu_count();
+    if (threads > count) threads = count;
+    
+    json_mutex_init(&batch.mutex);
+    
+    // The calling thread is one of the workers
+    JsonThread* workers = (threads > 1) ? (JsonThread*)JSON_MALLOC((threads - 1) * sizeof(JsonThread)) : NULL;
+    uint32_t started = 0;
+    if (workers) {
+      while (started < threads - 1 && json_thread_start(&workers[started], json_batch_run, &batch)) ++started;
+    }
+    
+    json_batch_run(&batch);
+    
+    for (uint32_t i = 0; i < started; ++i) {
+      json_thread_join(&workers[i]);
+    }
+    if (workers) JSON_FREE(workers);
+    
+    json_mutex_destroy(&batch.mutex);
+#endif
+    
+    json_set_allocator(previous);
+    return batch.parsed;
+  }
+  
+  // Incremental reparsing
+  
+  // Parses exactly length characters, ok is 0 if they aren't a single value
+  static JsonValue json_parse_spans(const json_char* text, uint64_t length, uint32_t flags, JsonSpans* spans, uint64_t base, json_bool* ok) {
+    JsonContext c = {};
+    c.is_parsing = 1;
+    c.flags = flags;
+    c.text = text;
+    c.len = length;
+    c.spans = spans;
+    c.span_base = base;
+    c.span_parent = JSON_SPAN_NONE;
+    
+    JsonValue value = {};
+    json_parse_value(&c, &value);
+    
+    // Only JSON whitespace, isspace() isn't defined for wide characters past 255
+    while (c.curr < c.len) {
+      json_char ch = c.text[c.curr];
+      if (ch != JSTR(' ') && ch != JSTR('\t') && ch != JSTR('\n') && ch != JSTR('\r')) break;
+      ++c.curr;
+    }
+    *ok = c.is_parsing && c.curr == c.len;
+    
+    return value;
+  }
+  
+  static void json_editor_parse(JsonEditor* editor) {
+    json_free(&editor->root);
+    editor->spans.count = 0;
+    
+    const int BOM_CHAR = 65279;
+    uint64_t start = (JSON_CHAR_MAX >= BOM_CHAR && editor->length > 0 && editor->text[0] == BOM_CHAR) ? 1 : 0;
+    
+    editor->root = json_parse_spans(editor->text + start, editor->length - start, editor->flags, &editor->spans, start, &editor->valid);
+  }
+  
+  json_bool json_editor_init(JsonEditor* editor, const json_char* text, uint32_t flags) {
+    memset(editor, 0, sizeof(JsonEditor));
+    
+    // Numbers can't point into text that moves with every edit
+    editor->flags = flags & ~(uint32_t)JSON_PARSE_LAZY_NUMBERS;
+    
+    editor->length = json_strlen(text);
+    editor->capacity = editor->length + 1;
+    editor->text = (json_char*)JSON_MALLOC((size_t)editor->capacity * sizeof(json_char));
+    if (!editor->text) return 0;
+    memcpy(editor->text, text, (size_t)editor->capacity * sizeof(json_char));
+    
+    json_editor_parse(editor);
+    return editor->valid;
+  }
+  
+  void json_editor_free(JsonEditor* editor) {
+    json_free(&editor->root);
+    if (editor->text) JSON_FREE(editor->text);
+    if (editor->spans.data) JSON_FREE(editor->spans.data);
+    memset(editor, 0, sizeof(JsonEditor));
+  }
+  
+  // Innermost array or object whose brackets are both outside [start, end)
+  static uint32_t json_editor_find(JsonEditor* editor, uint64_t start, uint64_t end) {
+    const JsonSpan* spans = editor->spans.data;
+    
+    // Last span that opens before the edit, the one we want is it or one of its parents
+    uint32_t low = 0;
+    uint32_t high = editor->spans.count;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      if (spans[mid].start < start) low = mid + 1;
+      else high = mid;
+    }
+    
+    uint32_t span = (low > 0) ? low - 1 : JSON_SPAN_NONE;
+    while (span != JSON_SPAN_NONE && spans[span].end <= end) span = spans[span].parent;
+    
+    return span;
+  }
+  
+  // The value a span was parsed into, found through the positions of its parents
+  static JsonValue* json_editor_value(JsonEditor* editor, uint32_t span) {
+    const JsonSpan* s = &editor->spans.data[span];
+    if (s->parent == JSON_SPAN_NONE) return &editor->root;
+    
+    JsonValue* parent = json_editor_value(editor, s->parent);
+    if (!parent) return NULL;
+    
+    if (parent->type == JSON_ARRAY) {
+      return (s->index < parent->array_value->count) ? &parent->array_value->values[s->index] : NULL;
+    }
+    
+    if (parent->type == JSON_OBJECT) {
+      uint32_t index = s->index;
+      for (JsonObject* obj = parent->object_value; obj != NULL; obj = obj->next) {
+        if (obj->key && index-- == 0) return obj->value;
+      }
+    }
+    
+    return NULL;
+  }
+  
+  // Swaps the spans of the old value for the fresh ones and moves everything after it by delta
+  static json_bool json_editor_splice(JsonEditor* editor, uint32_t span, JsonSpans* fresh, int64_t delta) {
+    JsonSpans* spans = &editor->spans;
+    JsonSpan old = spans->data[span];
+    
+    // The old value's children are the spans that open before it closes
+    uint32_t low = span + 1;
+    uint32_t high = spans->count;
+    while (low < high) {
+      uint32_t mid = low + (high - low) / 2;
+      if (spans->data[mid].start < old.end) low = mid + 1;
+      else high = mid;
+    }
+    uint32_t last = low;
+    
+    uint32_t removed = last - span;
+    uint32_t count = spans->count - removed + fresh->count;
+    if (count > spans->capacity) {
+      JsonSpan* data = (JsonSpan*)JSON_REALLOC(spans->data, count * sizeof(JsonSpan));
+      if (!data) return 0;
+      
+      spans->data = data;
+      spans->capacity = count;
+    }
+    
+    memmove(spans->data + span + fresh->count, spans->data + last, (spans->count - last) * sizeof(JsonSpan));
+    
+    for (uint32_t i = 0; i < fresh->count; ++i) {
+      JsonSpan* s = &spans->data[span + i];
+      *s = fresh->data[i];
+      
+      if (i == 0) {
+        s->parent = old.parent;
+        s->index = old.index;
+      } else {
+        s->parent += span;
+      }
+    }
+    
+    int64_t shift = (int64_t)fresh->count - (int64_t)removed;
+    for (uint32_t i = span + fresh->count; i < count; ++i) {
+      JsonSpan* s = &spans->data[i];
+      s->start += delta;
+      s->end += delta;
+      if (s->parent != JSON_SPAN_NONE && s->parent >= last) s->parent = (uint32_t)(s->parent + shift);
+    }
+    
+    for (uint32_t p = old.parent; p != JSON_SPAN_NONE; p = spans->data[p].parent) {
+      spans->data[p].end += delta;
+    }
+    
+    spans->count = count;
+    return 1;
+  }
+  
+  JsonValue* json_editor_replace(JsonEditor* editor, uint64_t offset, uint64_t length, const json_char* text, uint64_t text_length) {
+    if (offset > editor->length || length > editor->length - offset) return NULL;
+    
+    uint32_t span = (editor->valid) ? json_editor_find(editor, offset, offset + length) : JSON_SPAN_NONE;
+    
+    uint64_t new_length = editor->length - length + text_length;
+    if (new_length + 1 > editor->capacity) {
+      uint64_t capacity = editor->capacity * 2;
+      if (capacity < new_length + 1) capacity = new_length + 1;
+      
+      json_char* data = (json_char*)JSON_REALLOC(editor->text, (size_t)capacity * sizeof(json_char));
+      if (!data) return NULL;
+      
+      editor->text = data;
+      editor->capacity = capacity;
+    }
+    
+    json_char* at = editor->text + offset;
+    memmove(at + text_length, at + length, (size_t)(editor->length - offset - length + 1) * sizeof(json_char));
+    memcpy(at, text, (size_t)text_length * sizeof(json_char));
+    editor->length = new_length;
+    
+    int64_t delta = (int64_t)text_length - (int64_t)length;
+    
+    // Reparse the innermost container around the edit, if the edit broke it try the next one out
+    for (; span != JSON_SPAN_NONE; span = editor->spans.data[span].parent) {
+      const JsonSpan* s = &editor->spans.data[span];
+      uint64_t end = (uint64_t)((int64_t)s->end + delta);
+      
+      JsonSpans fresh = {};
+      json_bool ok;
+      JsonValue value = json_parse_spans(editor->text + s->start, end - s->start, editor->flags, &fresh, s->start, &ok);
+      
+      JsonValue* target = (ok) ? json_editor_value(editor, span) : NULL;
+      if (target && json_editor_splice(editor, span, &fresh, delta)) {
+        json_free(target);
+        *target = value;
+        
+        if (fresh.data) JSON_FREE(fresh.data);
+        return target;
+      }
+      
+      json_free(&value);
+      if (fresh.data) JSON_FREE(fresh.data);
+    }
+    
+    json_editor_parse(editor);
+    return &editor->root;
+  }
+  
+  // Memory accounting
+  
+  void json_memory_usage(JsonValue* json, JsonMemoryUsage* usage) {
+    if (!json) return;
+    
+    ++usage->values[json->type];
+    
+    switch (json->type) {
+      case JSON_STRING: {
+        if (!(json->flags & JSON_VALUE_BORROWED)) {
+          usage->bytes += (json_strlen(json->string_value) + 1) * sizeof(json_char);
+          ++usage->allocations;
+        }
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          usage->bytes += sizeof(JsonObject);
+          ++usage->allocations;
+          
+          // Nodes without a key are placeholders of empty objects, they don't have a value either
+          if (obj->value) {
+            usage->bytes += sizeof(JsonValue);
+            ++usage->allocations;
+          }
+          
+          if (!obj->key) continue;
+          
+          ++usage->members;
+          if (!(json->flags & JSON_VALUE_BORROWED)) {
+            usage->bytes += (json_strlen(obj->key) + 1) * sizeof(json_char);
+            ++usage->allocations;
+          }
+          
+          json_memory_usage(obj->value, usage);
+        }
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        JsonArray* arr = json->array_value;
+        usage->bytes += sizeof(JsonArray) + sizeof(JsonValue) * arr->capacity;
+        usage->slack_bytes += sizeof(JsonValue) * (arr->capacity - arr->count);
+        usage->allocations += (arr->values) ? 2 : 1;
+        
+        for (uint32_t i = 0; i < arr->count; ++i) {
+          json_memory_usage(&arr->values[i], usage);
+        }
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* arr = json->number_array_value;
+        usage->bytes += sizeof(JsonNumberArray) + sizeof(double) * arr->capacity;
+        usage->slack_bytes += sizeof(double) * (arr->capacity - arr->count);
+        usage->allocations += (arr->doubles) ? 2 : 1;
+        break;
+      }
+      
+      case JSON_NULL:
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER:
+      case JSON_BOOL: {
+        break;
+      }
+    }
+  }
+  
+  // Bytes json_compact_value() takes from the block, every piece is aligned like an arena allocation
+  static uint64_t json_compact_size(JsonValue* json) {
+    switch (json->type) {
+      case JSON_STRING: {
+        return json_arena_align((json_strlen(json->string_value) + 1) * sizeof(json_char));
+      }
+      
+      case JSON_OBJECT: {
+        uint64_t size = 0;
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          size += json_arena_align(sizeof(JsonObject)) + json_arena_align(sizeof(JsonValue));
+          size += json_arena_align((json_strlen(obj->key) + 1) * sizeof(json_char));
+          size += json_compact_size(obj->value);
+        }
+        return size;
+      }
+      
+      case JSON_ARRAY: {
+        JsonArray* arr = json->array_value;
+        uint64_t size = json_arena_align(sizeof(JsonArray));
+        if (arr->count > 0) size += json_arena_align(sizeof(JsonValue) * arr->count);
+        
+        for (uint32_t i = 0; i < arr->count; ++i) {
+          size += json_compact_size(&arr->values[i]);
+        }
+        return size;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* arr = json->number_array_value;
+        uint64_t size = json_arena_align(sizeof(JsonNumberArray));
+        if (arr->count > 0) size += json_arena_align(sizeof(double) * arr->count);
+        return size;
+      }
+      
+      case JSON_NULL:
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER:
+      case JSON_BOOL: {
+        return 0;
+      }
+    }
+    
+    return 0;
+  }
+  
+  // Like json_duplicate(), but without spare capacity
+  static JsonValue json_compact_value(JsonValue* json) {
+    switch (json->type) {
+      case JSON_STRING: {
+        return json_string(json->string_value);
+      }
+      
+      case JSON_OBJECT: {
+        JsonValue dup = json_object();
+        
+        JsonObject* tail = NULL;
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          JsonObject* node = json_alloc_object(obj->key, json_null());
+          *node->value = json_compact_value(obj->value);
+          
+          if (tail) tail->next = node;
+          else dup.object_value = node;
+          tail = node;
+        }
+        
+        return dup;
+      }
+      
+      case JSON_ARRAY: {
+        JsonValue dup = json_array();
+        
+        JsonArray* arr = dup.array_value;
+        if (json->array_value->count > 0) {
+          arr->capacity = json->array_value->count;
+          arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->capacity);
+          
+          for (uint32_t i = 0; i < json->array_value->count; ++i) {
+            arr->values[arr->count++] = json_compact_value(&json->array_value->values[i]);
+          }
+        }
+        
+        return dup;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* src = json->number_array_value;
+        JsonValue dup = json_number_array(NULL, 0);
+        
+        JsonNumberArray* arr = dup.number_array_value;
+        arr->is_integer = src->is_integer;
+        if (src->count > 0) {
+          arr->capacity = src->count;
+          arr->count = src->count;
+          arr->doubles = (double*)json_alloc_raw(sizeof(double) * arr->capacity);
+          memcpy(arr->doubles, src->doubles, sizeof(double) * arr->count);
+        }
+        
+        return dup;
+      }
+      
+      case JSON_RAW_NUMBER: {
+        // The compacted tree can outlive the text the literal is in
+        return json_number(json_get_number(json));
+      }
+      
+      case JSON_NULL:
+      case JSON_NUMBER:
+      case JSON_BOOL: {
+        return *json;
+      }
+    }
+    
+    return json_null();
+  }
+  
+  static json_bool json_compact_owns(JsonCompactTree* tree, void* ptr) {
+    return (uint8_t*)ptr >= (uint8_t*)tree->block && (uint8_t*)ptr < (uint8_t*)tree->block + tree->size;
+  }
+  
+  // Anything that doesn't fit in the block goes to the allocator that was set when it was compacted
+  static void* json_compact_allocate(void* user, size_t size) {
+    JsonCompactTree* tree = (JsonCompactTree*)user;
+    
+    uint64_t needed = json_arena_align(size);
+    if (tree->used + needed <= tree->size) {
+      void* ptr = (uint8_t*)tree->block + tree->used;
+      tree->used += needed;
+      return ptr;
+    }
+    
+    ++tree->outside;
+    if (tree->parent) return tree->parent->allocate(tree->parent->user, size);
+    return (void*)JSON_MALLOC(size);
+  }
+  
+  static void* json_compact_reallocate(void* user, void* ptr, size_t size) {
+    JsonCompactTree* tree = (JsonCompactTree*)user;
+    if (!ptr) return json_compact_allocate(user, size);
+    
+    if (!json_compact_owns(tree, ptr)) {
+      if (tree->parent) return tree->parent->reallocate(tree->parent->user, ptr, size);
+      return (void*)JSON_REALLOC(ptr, size);
+    }
+    
+    // The old size isn't known, but copying up to the end of the block keeps at least all of it
+    uint64_t available = (uint64_t)((uint8_t*)tree->block + tree->size - (uint8_t*)ptr);
+    void* moved = json_compact_allocate(user, size);
+    if (moved) memcpy(moved, ptr, (size_t)((available < size) ? available : size));
+    
+    return moved;
+  }
+  
+  // Pieces inside the block are only given back with the whole block
+  static void json_compact_deallocate(void* user, void* ptr) {
+    JsonCompactTree* tree = (JsonCompactTree*)user;
+    if (!ptr || json_compact_owns(tree, ptr)) return;
+    
+    --tree->outside;
+    if (tree->parent) tree->parent->deallocate(tree->parent->user, ptr);
+    else JSON_FREE(ptr);
+  }
+  
+  json_bool json_compact(JsonCompactTree* tree, JsonValue* json) {
+    memset(tree, 0, sizeof(JsonCompactTree));
+    
+    tree->parent = json_get_allocator();
+    tree->allocator.allocate = json_compact_allocate;
+    tree->allocator.reallocate = json_compact_reallocate;
+    tree->allocator.deallocate = json_compact_deallocate;
+    tree->allocator.user = tree;
+    
+    if (!json) return 0;
+    
+    tree->size = json_compact_size(json);
+    if (tree->size > 0) {
+      tree->block = json_mem_alloc((size_t)tree->size);
+      if (!tree->block) {
+        tree->size = 0;
+        return 0;
+      }
+    }
+    
+    const JsonAllocator* previous = json_set_allocator(&tree->allocator);
+    tree->root = json_compact_value(json);
+    json_set_allocator(previous);
+    
+    return 1;
+  }
+  
+  void json_compact_free(JsonCompactTree* tree) {
+    // Nothing left outside the block, no need to walk the tree
+    if (tree->outside > 0) json_free_with(&tree->root, &tree->allocator);
+    else json_storage_released();
+    
+    if (tree->block) {
+      const JsonAllocator* previous = json_set_allocator(tree->parent);
+      json_mem_free(tree->block);
+      json_set_allocator(previous);
+    }
+    
+    memset(tree, 0, sizeof(JsonCompactTree));
+  }
+  
+  // Output buffer for the serializer, either a fixed buffer that truncates or a heap buffer that grows
+  typedef struct {
+    json_char* data;
+    uint64_t size;
+    uint64_t capacity;
+    
+    json_bool growable;
+    json_bool truncated;
+  } JsonWriter;
+  
+  // Makes room for count characters plus the terminator, returns how many actually fit
+  static uint64_t json_writer_reserve(JsonWriter* w, uint64_t count) {
+    if (w->size + count + 1 > w->capacity) {
+      if (w->growable) {
+        uint64_t capacity = (w->capacity) ? w->capacity : 256;
+        while (capacity < w->size + count + 1) capacity *= 2;
+        
+        json_char* data = (json_char*)JSON_REALLOC(w->data, (size_t)capacity * sizeof(json_char));
+        if (data) {
+          w->data = data;
+          w->capacity = capacity;
+          return count;
+        }
+      }
+      
+      w->truncated = 1;
+      return (w->capacity > w->size + 1) ? w->capacity - w->size - 1 : 0;
+    }
+    
+    return count;
+  }
+  
+  static void json_writer_append(JsonWriter* w, const json_char* str, uint64_t count) {
+    count = json_writer_reserve(w, count);
+    if (count == 0) return;
+    
+    memcpy(w->data + w->size, str, (size_t)count * sizeof(json_char));
+    w->size += count;
+    w->data[w->size] = JSTR('\0');
+  }
+  
+  static void json_writer_char(JsonWriter* w, json_char c) {
+    if (json_writer_reserve(w, 1) == 0) return;
+    
+    w->data[w->size++] = c;
+    w->data[w->size] = JSTR('\0');
+  }
+  
+  static void json_writer_repeat(JsonWriter* w, json_char c, int count) {
+    if (count <= 0) return;
+    
+    uint64_t n = json_writer_reserve(w, (uint64_t)count);
+    for (uint64_t i = 0; i < n; ++i) {
+      w->data[w->size++] = c;
+    }
+    
+    if (w->capacity > 0) w->data[w->size] = JSTR('\0');
+  }
+  
+  static inline uint32_t json_ctz(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+  }
+  
+  static inline json_bool json_needs_escape(json_char c) {
+#ifdef JSON_USE_SINGLE_BYTE
+    uint32_t u = (uint8_t)c;
+#else
+    uint32_t u = (uint32_t)c;
+#endif
+    
+#ifdef JSON_ESCAPE_UNICODE
+    if (u >= 0x80) return 1;
+#endif
+    
+    return u < 0x20 || c == JSTR('"') || c == JSTR('\\');
+  }
+  
+  // Returns the number of characters before the first one that might need escaping.
+  // The vector paths may stop early on characters that turn out to be fine, callers re-check with json_needs_escape().
+  static uint64_t json_escape_scan(const json_char* str, uint64_t len) {
+    uint64_t i = 0;
+    
+#if defined(JSON_USE_SINGLE_BYTE) && defined(JSON_AVX2)
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    const __m256i control32 = _mm256_set1_epi8(0x1F);
+    
+    for (; i + 32 <= len; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(str + i));
+      __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, backslash32));
+      hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_max_epu8(v, control32), control32));
+#  ifdef JSON_ESCAPE_UNICODE
+      hit = _mm256_or_si256(hit, v);
+#  endif
+      
+      uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+      if (mask) return i + json_ctz(mask);
+    }
+#endif
+    
+#if defined(JSON_USE_SINGLE_BYTE) && defined(JSON_SSE2)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    
+    for (; i + 16 <= len; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+      
+      // Unsigned v <= 0x1F
+      hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+#  ifdef JSON_ESCAPE_UNICODE
+      // The high bit is already set for every non-ASCII byte
+      hit = _mm_or_si128(hit, v);
+#  endif
+      
+      uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+      if (mask) return i + json_ctz(mask);
+    }
+#elif !defined(JSON_USE_SINGLE_BYTE) && defined(JSON_SSE2) && WCHAR_MAX > 0xFFFF
+    // 4 characters of 32 bits per vector
+    const __m128i quote = _mm_set1_epi32('"');
+    const __m128i backslash = _mm_set1_epi32('\\');
+    const __m128i space = _mm_set1_epi32(0x20);
+#  ifdef JSON_ESCAPE_UNICODE
+    const __m128i ascii = _mm_set1_epi32(0x7F);
+#  endif
+    
+    for (; i + 4 <= len; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi32(v, quote), _mm_cmpeq_epi32(v, backslash));
+      hit = _mm_or_si128(hit, _mm_cmplt_epi32(v, space));
+#  ifdef JSON_ESCAPE_UNICODE
+      hit = _mm_or_si128(hit, _mm_cmpgt_epi32(v, ascii));
+#  endif
+      
+      uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+      if (mask) return i + json_ctz(mask) / 4;
+    }
+#elif !defined(JSON_USE_SINGLE_BYTE) && defined(JSON_SSE2)
+    // 8 characters of 16 bits per vector, the signed compare also flags 0x8000 and up
+    const __m128i quote = _mm_set1_epi16('"');
+    const __m128i backslash = _mm_set1_epi16('\\');
+    const __m128i space = _mm_set1_epi16(0x20);
+#  ifdef JSON_ESCAPE_UNICODE
+    const __m128i ascii = _mm_set1_epi16(0x7F);
+#  endif
+    
+    for (; i + 8 <= len; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+      __m128i hit = _mm_or_si128(_mm_cmpeq_epi16(v, quote), _mm_cmpeq_epi16(v, backslash));
+      hit = _mm_or_si128(hit, _mm_cmplt_epi16(v, space));
+#  ifdef JSON_ESCAPE_UNICODE
+      hit = _mm_or_si128(hit, _mm_cmpgt_epi16(v, ascii));
+#  endif
+      
+      uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+      if (mask) return i + json_ctz(mask) / 2;
+    }
+#endif
+    
+    for (; i < len; ++i) {
+      if (json_needs_escape(str[i])) return i;
+    }
+    
+    return len;
+  }
+  
+  static void json_write_unicode_escape(JsonWriter* w, uint32_t unit) {
+    static const char HEX[] = "0123456789abcdef";
+    
+    json_char escape[6] = {
+      JSTR('\\'), JSTR('u'),
+      (json_char)HEX[(unit >> 12) & 0xF], (json_char)HEX[(unit >> 8) & 0xF],
+      (json_char)HEX[(unit >> 4) & 0xF], (json_char)HEX[unit & 0xF]
+    };
+    json_writer_append(w, escape, 6);
+  }
+  
+  static void json_write_string(JsonWriter* w, const json_char* str) {
+    uint64_t len = json_strlen(str);
+    
+    json_writer_char(w, JSTR('"'));
+    
+    uint64_t i = 0;
+    while (i < len) {
+      // Copy everything up to the next special character at once
+      uint64_t run = json_escape_scan(str + i, len - i);
+      json_writer_append(w, str + i, run);
+      i += run;
+      if (i >= len) break;
+      
+      json_char c = str[i++];
+      if (!json_needs_escape(c)) {
+        json_writer_char(w, c);
+        continue;
+      }
+      
+      switch (c) {
+        case JSTR('"'):  json_writer_append(w, JSTR("\\\""), 2); break;
+        case JSTR('\\'): json_writer_append(w, JSTR("\\\\"), 2); break;
+        case JSTR('\b'): json_writer_append(w, JSTR("\\b"), 2); break;
+        case JSTR('\f'): json_writer_append(w, JSTR("\\f"), 2); break;
+        case JSTR('\n'): json_writer_append(w, JSTR("\\n"), 2); break;
+        case JSTR('\r'): json_writer_append(w, JSTR("\\r"), 2); break;
+        case JSTR('\t'): json_writer_append(w, JSTR("\\t"), 2); break;
+        
+        default: {
+#ifdef JSON_USE_SINGLE_BYTE
+          uint32_t cp = (uint8_t)c;
+          if (cp >= 0x80) {
+            // Decode the whole UTF-8 sequence, invalid bytes become U+FFFD
+            uint64_t next = i - 1;
+            cp = json_utf8_decode((const uint8_t*)str, len, &next);
+            if (next == i && cp >= 0x80) cp = 0xFFFD;
+            i = next;
+          }
+#else
+          uint32_t cp = (uint32_t)c;
+#endif
+          
+          if (cp > 0xFFFF) {
+            cp -= 0x10000;
+            json_write_unicode_escape(w, 0xD800 + (cp >> 10));
+            json_write_unicode_escape(w, 0xDC00 + (cp & 0x3FF));
+          } else {
+            json_write_unicode_escape(w, cp);
+          }
+        }
+      }
+    }
+    
+    json_writer_char(w, JSTR('"'));
+  }
+  
+  static void json_write_int64(JsonWriter* w, int64_t value) {
+    json_char digits[24];
+    uint32_t i = 24;
+    
+    uint64_t magnitude = (value < 0) ? 0 - (uint64_t)value : (uint64_t)value;
+    do {
+      digits[--i] = (json_char)(JSTR('0') + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude);
+    
+    if (value < 0) digits[--i] = JSTR('-');
+    
+    json_writer_append(w, digits + i, 24 - i);
+  }
+  
+  static void json_write_number(JsonWriter* w, double value) {
+    // Check if number has a decimal place, and fits in a 64-bit integer
+    if (fmod(value, 1.0) == 0.0 && fabs(value) < 1e18) {
+      json_write_int64(w, (int64_t)value);
+      return;
+    }
+    
+    json_char num[64];
+    json_sprintf(num, 64, JSTR("%.6g"), value);
+    json_writer_append(w, num, json_strlen(num));
+  }
+  
+  static void json_write_value(JsonWriter* w, JsonValue* value, int indent_level, json_bool minified) {
+    switch (value->type) {
+      case JSON_NULL: {
+        json_writer_append(w, JSTR("null"), 4);
+        break;
+      }
+      
+      case JSON_STRING: {
+        json_write_string(w, value->string_value);
+        break;
+      }
+      
+      case JSON_NUMBER: {
+        json_write_number(w, value->number_value);
+        break;
+      }
+      
+      case JSON_RAW_NUMBER: {
+        json_writer_append(w, value->raw_number, json_number_length(value->raw_number));
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        json_writer_char(w, JSTR('{'));
+        if (!minified) json_writer_char(w, JSTR('\n'));
+        
+        for (JsonObject* obj = value->object_value; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level);
+          json_write_string(w, obj->key);
+          json_writer_char(w, JSTR(':'));
+          if (!minified) json_writer_char(w, JSTR(' '));
+          
+          json_write_value(w, obj->value, indent_level + JSON_INDENT_STEP, minified);
+          
+          if (obj->next) json_writer_char(w, JSTR(','));
+          if (!minified) json_writer_char(w, JSTR('\n'));
+        }
+        
+        if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level - JSON_INDENT_STEP);
+        json_writer_char(w, JSTR('}'));
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        json_writer_char(w, JSTR('['));
+        if (!minified) json_writer_char(w, JSTR('\n'));
+        
+        for (uint32_t i = 0; i < value->array_value->count; ++i) {
+          if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level);
+          json_write_value(w, &value->array_value->values[i], indent_level + JSON_INDENT_STEP, minified);
+          
+          if (i + 1 < value->array_value->count) json_writer_char(w, JSTR(','));
+          if (!minified) json_writer_char(w, JSTR('\n'));
+        }
+        
+        if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level - JSON_INDENT_STEP);
+        json_writer_char(w, JSTR(']'));
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* arr = value->number_array_value;
+        
+        json_writer_char(w, JSTR('['));
+        if (!minified) json_writer_char(w, JSTR('\n'));
+        
+        // Same layout as JSON_ARRAY, without going through json_write_value() for every element
+        for (uint32_t i = 0; i < arr->count; ++i) {
+          if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level);
+          
+          if (arr->is_integer) json_write_int64(w, arr->integers[i]);
+          else json_write_number(w, arr->doubles[i]);
+          
+          if (i + 1 < arr->count) json_writer_char(w, JSTR(','));
+          if (!minified) json_writer_char(w, JSTR('\n'));
+        }
+        
+        if (!minified) json_writer_repeat(w, JSON_INDENT_CHAR, indent_level - JSON_INDENT_STEP);
+        json_writer_char(w, JSTR(']'));
+        break;
+      }
+      
+      case JSON_BOOL: {
+        if (value->bool_value) json_writer_append(w, JSTR("true"), 4);
+        else json_writer_append(w, JSTR("false"), 5);
+        break;
+      }
+    }
+  }
+  
+  json_bool json_stringify(JsonValue* value, json_char* out, int out_size, int indent_level, json_bool minified) {
+    if (!value || !out || out_size <= 0) return 0;
+    
+    JsonWriter w = {};
+    w.data = out;
+    w.capacity = (uint64_t)out_size;
+    w.data[0] = JSTR('\0');
+    
+    json_write_value(&w, value, indent_level, minified);
+    JSON_STATS(json_stats->bytes_written += w.size * sizeof(json_char));
+    
+    return !w.truncated;
+  }
+  
+  json_char* json_stringify_alloc(JsonValue* value, json_bool minified, uint64_t* length) {
+    if (!value) return NULL;
+    
+    JsonWriter w = {};
+    w.growable = 1;
+    
+    json_write_value(&w, value, JSON_INDENT_STEP, minified);
+    
+    if (w.truncated) {
+      if (w.data) JSON_FREE(w.data);
+      return NULL;
+    }
+    
+    JSON_STATS(json_stats->bytes_written += w.size * sizeof(json_char));
+    
+    if (length) *length = w.size;
+    return w.data;
+  }
+  
+  // Canonical form (RFC 8785): no whitespace, members sorted by their UTF-16 code units, numbers like JavaScript prints them
+  typedef struct {
+    const json_char* str;
+    uint64_t length;
+    uint64_t i;
+    
+    // Second half of a surrogate pair
+    uint32_t low;
+  } JsonUtf16Reader;
+  
+  // Next UTF-16 code unit, 0 at the end
+  static uint32_t json_next_utf16(JsonUtf16Reader* r) {
+    if (r->low) {
+      uint32_t unit = r->low;
+      r->low = 0;
+      return unit;
+    }
+    
+    if (r->i >= r->length) return 0;
+    
+#ifdef JSON_USE_SINGLE_BYTE
+    uint32_t cp = json_utf8_decode((const uint8_t*)r->str, r->length, &r->i);
+#else
+    uint32_t cp = (uint32_t)r->str[r->i++];
+#endif
+    
+    if (cp > 0xFFFF) {
+      cp -= 0x10000;
+      r->low = 0xDC00 + (cp & 0x3FF);
+      return 0xD800 + (cp >> 10);
+    }
+    
+    return cp;
+  }
+  
+  static int json_compare_members(const void* x, const void* y) {
+    const json_char* a = (*(JsonObject* const*)x)->key;
+    const json_char* b = (*(JsonObject* const*)y)->key;
+    
+    JsonUtf16Reader ra = { a, json_strlen(a), 0, 0 };
+    JsonUtf16Reader rb = { b, json_strlen(b), 0, 0 };
+    
+    for (;;) {
+      uint32_t ua = json_next_utf16(&ra);
+      uint32_t ub = json_next_utf16(&rb);
+      
+      if (ua != ub) return (ua < ub) ? -1 : 1;
+      if (ua == 0) return 0;
+    }
+  }
+  
+  // Only quotes, backslashes and control characters are escaped, everything else is written as is
+  static void json_write_canonical_string(JsonWriter* w, const json_char* str) {
+    json_writer_char(w, JSTR('"'));
+    
+    const json_char* run = str;
+    for (const json_char* s = str; *s; ++s) {
+      json_char c = *s;
+      if (c != JSTR('"') && c != JSTR('\\') && (uint32_t)c >= 0x20) continue;
+      
+      json_writer_append(w, run, (uint64_t)(s - run));
+      run = s + 1;
+      
+      switch (c) {
+        case JSTR('"'):  json_writer_append(w, JSTR("\\\""), 2); break;
+        case JSTR('\\'): json_writer_append(w, JSTR("\\\\"), 2); break;
+        case JSTR('\b'): json_writer_append(w, JSTR("\\b"), 2); break;
+        case JSTR('\f'): json_writer_append(w, JSTR("\\f"), 2); break;
+        case JSTR('\n'): json_writer_append(w, JSTR("\\n"), 2); break;
+        case JSTR('\r'): json_writer_append(w, JSTR("\\r"), 2); break;
+        case JSTR('\t'): json_writer_append(w, JSTR("\\t"), 2); break;
+        default: json_write_unicode_escape(w, (uint32_t)c);
+      }
+    }
+    
+    json_writer_append(w, run, json_strlen(run));
+    json_writer_char(w, JSTR('"'));
+  }
+  
+  // Shortest digits that read back as the same double, laid out like Number.prototype.toString()
+  static void json_write_canonical_number(JsonWriter* w, double value) {
+    // RFC 8785 has no form for them, e.g. 1e400 parses to infinity
+    if (value != value || value - value != 0) {
+      w->truncated = 1;
+      return;
+    }
+    
+    if (value == 0.0) {
+      json_writer_char(w, JSTR('0'));
+      return;
+    }
+    
+    char text[32];
+    for (int precision = 1; precision <= 17; ++precision) {
+      snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+      if (strtod(text, NULL) == value) break;
+    }
+    
+    // text is [-]d[.ddd]e[+-]x
+    const char* t = text;
+    json_bool negative = (*t == '-');
+    if (negative) ++t;
+    
+    char digits[20];
+    int k = 0;
+    for (; *t && *t != 'e' && k < (int)sizeof(digits); ++t) {
+      if (*t != '.') digits[k++] = *t;
+    }
+    while (k > 1 && digits[k - 1] == '0') --k;
+    
+    // value = 0.digits * 10^n
+    int n = (*t == 'e') ? atoi(t + 1) + 1 : k;
+    
+    json_char out[64];
+    int o = 0;
+    if (negative) out[o++] = JSTR('-');
+    
+    if (k <= n && n <= 21) {
+      for (int i = 0; i < k; ++i) out[o++] = (json_char)digits[i];
+      for (int i = k; i < n; ++i) out[o++] = JSTR('0');
+    } else if (0 < n && n <= 21) {
+      for (int i = 0; i < n; ++i) out[o++] = (json_char)digits[i];
+      out[o++] = JSTR('.');
+      for (int i = n; i < k; ++i) out[o++] = (json_char)digits[i];
+    } else if (-6 < n && n <= 0) {
+      out[o++] = JSTR('0');
+      out[o++] = JSTR('.');
+      for (int i = n; i < 0; ++i) out[o++] = JSTR('0');
+      for (int i = 0; i < k; ++i) out[o++] = (json_char)digits[i];
+    } else {
+      out[o++] = (json_char)digits[0];
+      if (k > 1) {
+        out[o++] = JSTR('.');
+        for (int i = 1; i < k; ++i) out[o++] = (json_char)digits[i];
+      }
+      
+      out[o++] = JSTR('e');
+      out[o++] = (n - 1 < 0) ? JSTR('-') : JSTR('+');
+      
+      int exponent = (n - 1 < 0) ? 1 - n : n - 1;
+      json_char exp_digits[8];
+      int e = 0;
+      do {
+        exp_digits[e++] = (json_char)(JSTR('0') + exponent % 10);
+        exponent /= 10;
+      } while (exponent);
+      while (e > 0) out[o++] = exp_digits[--e];
+    }
+    
+    json_writer_append(w, out, (uint64_t)o);
+  }
+  
+  static void json_write_canonical(JsonWriter* w, JsonValue* value) {
+    switch (value->type) {
+      case JSON_NULL: {
+        json_writer_append(w, JSTR("null"), 4);
+        break;
+      }
+      
+      case JSON_BOOL: {
+        if (value->bool_value) json_writer_append(w, JSTR("true"), 4);
+        else json_writer_append(w, JSTR("false"), 5);
+        break;
+      }
+      
+      case JSON_STRING: {
+        json_write_canonical_string(w, value->string_value);
+        break;
+      }
+      
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER: {
+        json_write_canonical_number(w, json_get_number(value));
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        json_writer_char(w, JSTR('['));
+        for (uint32_t i = 0; i < value->number_array_value->count; ++i) {
+          if (i > 0) json_writer_char(w, JSTR(','));
+          json_write_canonical_number(w, json_number_array_get(value, i));
+        }
+        json_writer_char(w, JSTR(']'));
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        json_writer_char(w, JSTR('['));
+        for (uint32_t i = 0; i < value->array_value->count; ++i) {
+          if (i > 0) json_writer_char(w, JSTR(','));
+          json_write_canonical(w, &value->array_value->values[i]);
+        }
+        json_writer_char(w, JSTR(']'));
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        uint32_t count = 0;
+        for (JsonObject* obj = value->object_value; obj != NULL; obj = obj->next) {
+          if (obj->key) ++count;
+        }
+        
+        JsonObject** members = (count) ? (JsonObject**)JSON_MALLOC(count * sizeof(JsonObject*)) : NULL;
+        if (count && !members) {
+          w->truncated = 1;
+          return;
+        }
+        
+        count = 0;
+        for (JsonObject* obj = value->object_value; obj != NULL; obj = obj->next) {
+          if (obj->key) members[count++] = obj;
+        }
+        
+        if (count > 1) qsort(members, count, sizeof(JsonObject*), json_compare_members);
+        
+        json_writer_char(w, JSTR('{'));
+        for (uint32_t i = 0; i < count; ++i) {
+          if (i > 0) json_writer_char(w, JSTR(','));
+          json_write_canonical_string(w, members[i]->key);
+          json_writer_char(w, JSTR(':'));
+          json_write_canonical(w, members[i]->value);
+        }
+        json_writer_char(w, JSTR('}'));
+        
+        if (members) JSON_FREE(members);
+        break;
+      }
+    }
+  }
+  
+  json_char* json_stringify_canonical(JsonValue* value, uint64_t* length) {
+    if (!value) return NULL;
+    
+    JsonWriter w = {};
+    w.growable = 1;
+    
+    json_write_canonical(&w, value);
+    
+    if (w.truncated) {
+      if (w.data) JSON_FREE(w.data);
+      return NULL;
+    }
+    
+    JSON_STATS(json_stats->bytes_written += w.size * sizeof(json_char));
+    
+    if (length) *length = w.size;
+    return w.data;
+  }
+  
+  json_bool json_export(JsonValue* json, const char* path, json_bool minified) {
+    if (!json || !path) return 0;
+    
+    uint64_t length;
+    json_char* out = json_stringify_alloc(json, minified, &length);
+    if (!out) return 0;
+    
+    FILE* file = fopen(path, JSON_WRITE_MODE);
+    
+    if (!file) {
+      printf("Could not create file for writing '%s'\n", path);
+      JSON_FREE(out);
+      return 0;
+    }
+    
+    fwrite(out, (size_t)length * sizeof(json_char), 1, file);
+    fflush(file);
+    fclose(file);
+    
+    JSON_FREE(out);
+    
+    return 1;
+  }
+  
+  JsonValue* json_get_field(JsonValue* json, const json_char* key) {
+    if (!json || !key || json->type != JSON_OBJECT) return NULL;
+    
+    uint32_t key_hash = json_hash_key(key, NULL);
+    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+      if (v->key && v->key_hash == key_hash && json_strcmp(key, v->key) == 0) {
+        return v->value;
+      }
+    }
+    
+    return NULL;
+  }
+  
+#ifdef __cplusplus
+  
+  JsonValue& json_get_field_ref(JsonValue* json, const json_char* key) {
+    JsonValue* field = json_get_field(json, key);
+    if (field) return *field;
+    
+    // Same as operator[], a per-thread null value instead of a reference to a local
+    static thread_local JsonValue missing;
+    missing = json_null();
+    return missing;
+  }
+  
+#endif
+  
+  int json_field_count(JsonValue* json, const json_char* key) {
+    int count = 0;
+    
+    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+      if (json_strcmp(key, v->key) == 0) {
+        ++count;
+      }
+    }
+    
+    return count;
+  }
+
+  double json_get_number(JsonValue* json) {
+    if (!json) return 0.0;
+  
+    if (json->type == JSON_NUMBER) return json->number_value;
+    if (json->type == JSON_RAW_NUMBER) {
+      return json_number_from_text(json->raw_number, json_number_length(json->raw_number));
+    }
+  
+    return 0.0;
+  }
+  
+  int64_t json_get_int64(JsonValue* json) {
+    if (!json) return 0;
+  
+    if (json->type == JSON_NUMBER) return (int64_t)json->number_value;
+    if (json->type == JSON_RAW_NUMBER) {
+      const json_char* p = json->raw_number;
+      uint32_t length = json_number_length(p);
+  
+      // Integer literals are converted exactly, even beyond 2^53
+      if (json_is_integer_literal(p, length)) return (int64_t)json_strtoll(p, NULL, 10);
+  
+      return (int64_t)json_number_from_text(p, length);
+    }
+  
+    return 0;
+  }
+  
+  // Reference counts of shared arrays and objects, any owner can be on another thread
+#ifdef _WIN32
+  static void json_refs_add(uint32_t* refs) { InterlockedIncrement((volatile LONG*)refs); }
+  static uint32_t json_refs_load(uint32_t* refs) { return (uint32_t)InterlockedCompareExchange((volatile LONG*)refs, 0, 0); }
+  static uint32_t json_refs_sub(uint32_t* refs) { return (uint32_t)InterlockedDecrement((volatile LONG*)refs) + 1; }
+#else
+  static void json_refs_add(uint32_t* refs) { __atomic_add_fetch(refs, 1, __ATOMIC_RELAXED); }
+  static uint32_t json_refs_load(uint32_t* refs) { return __atomic_load_n(refs, __ATOMIC_ACQUIRE); }
+  static uint32_t json_refs_sub(uint32_t* refs) { return __atomic_fetch_sub(refs, 1, __ATOMIC_ACQ_REL); }
+#endif
+  
+  // Drops one owner, returns 1 if it was the last one and the caller has to free it
+  static json_bool json_refs_release(uint32_t* refs) {
+    // A unique owner can't race with anyone, no other thread has a copy to share or free
+    if (json_refs_load(refs) == 0) return 1;
+    if (json_refs_sub(refs) != 0) return 0;
+    
+    // The other owners let go in the meantime, the count is back at unique for json_free()
+    *refs = 0;
+    return 1;
+  }
+  
+  void json_free(JsonValue* json) {
+    if (!json) return;
+    
+    switch (json->type) {
+      case JSON_STRING: {
+        if (!(json->flags & JSON_VALUE_BORROWED)) json_mem_free(json->string_value);
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        // Other owners are still using it
+        if (json->object_value && !json_refs_release(&json->object_value->refs)) break;
+        if (json->object_value) json_storage_released();
+        
+        JsonObject* head = json->object_value;
+        JsonObject* tmp;
+        
+        while (head) {
+          tmp = head;
+          head = head->next;
+          
+          if (!(json->flags & JSON_VALUE_BORROWED)) json_mem_free(tmp->key);
+          json_free(tmp->value);
+          json_mem_free(tmp->value);
+          json_mem_free(tmp);
+        }
+        
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        if (!json_refs_release(&json->array_value->refs)) break;
+        json_storage_released();
+        
+        for (int i = 0; i < (int)json->array_value->count; ++i) {
+          json_free(&json->array_value->values[i]);
+        }
+        json_mem_free(json->array_value->values);
+        json_mem_free(json->array_value);
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        if (!json_refs_release(&json->number_array_value->refs)) break;
+        json_storage_released();
+        
+        json_mem_free(json->number_array_value->doubles);
+        json_mem_free(json->number_array_value);
+        break;
+      }
+      
+      case JSON_NULL:
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER:
+      case JSON_BOOL: {
+        break;
+      }
+    }
+    
+    *json = json_null();
+  }
+  
+  void json_free_with(JsonValue* json, const JsonAllocator* allocator) {
+    const JsonAllocator* previous = json_set_allocator(allocator);
+    json_free(json);
+    json_set_allocator(previous);
+  }
+  
+  JsonValue json_duplicate(JsonValue* json) {
+    if (!json) return json_null();
+    
+    switch (json->type) {
+      case JSON_NULL: {
+        return json_null();
+      }
+      
+      case JSON_STRING: {
+        return json_string(json->string_value);
+      }
+      
+      case JSON_NUMBER: {
+        return json_number(json->number_value);
+      }
+      
+      case JSON_RAW_NUMBER: {
+        // The copy can outlive the text the literal is in
+        return json_number(json_get_number(json));
+      }
+      
+      case JSON_OBJECT: {
+        JsonValue dup = json_object();
+        
+        // Keep track of the tail, json_add_field() would walk the whole list for every field
+        JsonObject* tail = NULL;
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          JsonObject* node = json_alloc_object(obj->key, json_duplicate(obj->value));
+          if (tail) tail->next = node;
+          else dup.object_value = node;
+          tail = node;
+        }
+        
+        return dup;
+      }
+      
+      case JSON_ARRAY: {
+        JsonValue dup = json_array();
+        
+        JsonArray* arr = dup.array_value;
+        if (json->array_value->count > 0) {
+          arr->capacity = json->array_value->count;
+          arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->capacity);
+          
+          for (uint32_t i = 0; i < json->array_value->count; ++i) {
+            arr->values[arr->count++] = json_duplicate(&json->array_value->values[i]);
+          }
+        }
+        
+        return dup;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* arr = json->number_array_value;
+        if (arr->is_integer) return json_int64_array(arr->integers, arr->count);
+        return json_number_array(arr->doubles, arr->count);
+      }
+      
+      case JSON_BOOL: {
+        return json_boolean(json->bool_value);
+      }
+    }
+    
+    return json_null();
+  }
+  
+  JsonValue json_duplicate_with(JsonValue* json, const JsonAllocator* allocator) {
+    const JsonAllocator* previous = json_set_allocator(allocator);
+    JsonValue dup = json_duplicate(json);
+    json_set_allocator(previous);
+    
+    return dup;
+  }
+  
+  JsonValue json_share(JsonValue* json) {
+    if (!json) return json_null();
+    
+    switch (json->type) {
+      case JSON_OBJECT: {
+        if (json->object_value) json_refs_add(&json->object_value->refs);
+        return *json;
+      }
+      
+      case JSON_ARRAY: {
+        json_refs_add(&json->array_value->refs);
+        return *json;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        json_refs_add(&json->number_array_value->refs);
+        return *json;
+      }
+      
+      default: {
+        // Strings aren't reference counted, they're small enough to copy
+        return json_duplicate(json);
+      }
+    }
+  }
+  
+  void json_make_unique(JsonValue* json) {
+    if (!json) return;
+    
+    // The other owners may have freed theirs while this one copied, then the original is ours to free
+    JsonValue original = *json;
+    
+    switch (json->type) {
+      case JSON_OBJECT: {
+        JsonObject* shared = json->object_value;
+        if (!shared || json_refs_load(&shared->refs) == 0) return;
+        
+        // Copy this level only, the children are shared with the other owners
+        JsonObject* head = NULL;
+        JsonObject* tail = NULL;
+        for (JsonObject* obj = shared; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          JsonObject* node = json_alloc_object(obj->key, json_share(obj->value));
+          if (tail) tail->next = node;
+          else head = node;
+          tail = node;
+        }
+        
+        json->object_value = head;
+        json->flags &= ~JSON_VALUE_BORROWED;
+        if (json_refs_release(&shared->refs)) json_free(&original);
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        JsonArray* shared = json->array_value;
+        if (json_refs_load(&shared->refs) == 0) return;
+        
+        JsonArray* arr = (JsonArray*)json_alloc(sizeof(JsonArray));
+        if (shared->count > 0) {
+          arr->capacity = shared->count;
+          arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->capacity);
+          
+          for (uint32_t i = 0; i < shared->count; ++i) {
+            arr->values[arr->count++] = json_share(&shared->values[i]);
+          }
+        }
+        
+        json->array_value = arr;
+        if (json_refs_release(&shared->refs)) json_free(&original);
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        JsonNumberArray* shared = json->number_array_value;
+        if (json_refs_load(&shared->refs) == 0) return;
+        
+        JsonValue copy = json_duplicate(json);
+        
+        json->number_array_value = copy.number_array_value;
+        if (json_refs_release(&shared->refs)) json_free(&original);
+        break;
+      }
+      
+      default: {
+        break;
+      }
+    }
+  }
+  
+  JsonValue* json_get_field_mut(JsonValue* json, const json_char* key) {
+    if (!json || !key || json->type != JSON_OBJECT) return NULL;
+    
+    json_make_unique(json);
+    
+    JsonValue* field = json_get_field(json, key);
+    json_make_unique(field);
+    
+    return field;
+  }
+  
+  JsonValue* json_get_element_mut(JsonValue* json, uint32_t index) {
+    if (!json || json->type != JSON_ARRAY || index >= json->array_value->count) return NULL;
+    
+    json_make_unique(json);
+    
+    JsonValue* element = &json->array_value->values[index];
+    json_make_unique(element);
+    
+    return element;
+  }
+  
+  // Patching
+  
+  // Replaces remove_count elements at index with insert_count values in a single move, removed elements aren't freed
+  static void json_array_splice(JsonArray* arr, uint32_t index, uint32_t remove_count, const JsonValue* values, uint32_t insert_count) {
+    uint32_t count = arr->count - remove_count + insert_count;
+    
+    if (count > arr->capacity) {
+      // @HARDCODED
+      uint32_t capacity = (arr->capacity) ? arr->capacity : 32;
+      while (capacity < count) capacity *= 2;
+      
+      if (arr->values) arr->values = (JsonValue*)json_mem_realloc(arr->values, sizeof(JsonValue) * capacity);
+      else arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * capacity);
+      arr->capacity = capacity;
+    }
+    
+    uint32_t tail = arr->count - index - remove_count;
+    if (tail > 0 && remove_count != insert_count) {
+      memmove(arr->values + index + insert_count, arr->values + index + remove_count, tail * sizeof(JsonValue));
+    }
+    if (insert_count > 0) memcpy(arr->values + index, values, insert_count * sizeof(JsonValue));
+    
+    arr->count = count;
+  }
+  
+  void json_splice_elements(JsonValue* json, uint32_t index, uint32_t remove_count, const JsonValue* values, uint32_t insert_count) {
+    assert(json->type == JSON_ARRAY);
+    
+    json_make_unique(json);
+    
+    JsonArray* arr = json->array_value;
+    if (index > arr->count) index = arr->count;
+    if (remove_count > arr->count - index) remove_count = arr->count - index;
+    
+    for (uint32_t i = index; i < index + remove_count; ++i) {
+      json_free(&arr->values[i]);
+    }
+    
+    json_array_splice(arr, index, remove_count, values, insert_count);
+  }
+  
+  JsonValue* json_set_field(JsonValue* json, const json_char* key, JsonValue value) {
+    assert(json->type == JSON_OBJECT);
+    
+    json_make_unique(json);
+    
+    // Replace it if it exists, otherwise the same walk has found the tail
+    uint32_t key_hash = json_hash_key(key, NULL);
+    JsonObject* tail = NULL;
+    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+      if (v->key && v->key_hash == key_hash && json_strcmp(key, v->key) == 0) {
+        json_free(v->value);
+        *v->value = value;
+        return v->value;
+      }
+      tail = v;
+    }
+    
+    json_own_keys(json);
+    
+    JsonObject* node = json_alloc_object(key, value);
+    if (tail) tail->next = node;
+    else json->object_value = node;
+    
+    return node->value;
+  }
+  
+  // Unlinks the first field with key, the caller frees it with json_free_field()
+  static JsonObject* json_unlink_field(JsonValue* json, const json_char* key) {
+    uint32_t key_hash = json_hash_key(key, NULL);
+    
+    JsonObject* prev = NULL;
+    for (JsonObject* v = json->object_value; v != NULL; prev = v, v = v->next) {
+      if (v->key && v->key_hash == key_hash && json_strcmp(key, v->key) == 0) {
+        if (prev) prev->next = v->next;
+        else json->object_value = v->next;
+        
+        v->next = NULL;
+        return v;
+      }
+    }
+    
+    return NULL;
+  }
+  
+  // Frees the node and its key, not the value it points to
+  static void json_free_field(JsonValue* json, JsonObject* node) {
+    // It may have been the head of the object, which is what a JsonHashCache knows it by
+    json_storage_released();
+    
+    if (!(json->flags & JSON_VALUE_BORROWED)) json_mem_free(node->key);
+    json_mem_free(node->value);
+    json_mem_free(node);
+  }
+  
+  json_bool json_remove_field(JsonValue* json, const json_char* key) {
+    if (!json || !key || json->type != JSON_OBJECT) return 0;
+    
+    json_make_unique(json);
+    
+    JsonObject* node = json_unlink_field(json, key);
+    if (!node) return 0;
+    
+    json_free(node->value);
+    json_free_field(json, node);
+    return 1;
+  }
+  
+  static uint32_t json_member_count(JsonValue* json) {
+    uint32_t count = 0;
+    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+      if (v->key) ++count;
+    }
+    
+    return count;
+  }
+  
+  static inline json_bool json_is_any_number(JsonValue* json) {
+    return json->type == JSON_NUMBER || json->type == JSON_RAW_NUMBER;
+  }
+  
+  static inline json_bool json_is_any_array(JsonValue* json) {
+    return json->type == JSON_ARRAY || json->type == JSON_NUMBER_ARRAY;
+  }
+  
+  // Element of either kind of array, number array elements are converted into storage
+  static inline JsonValue* json_any_element(JsonValue* json, uint32_t index, JsonValue* storage) {
+    if (json->type == JSON_ARRAY) return &json->array_value->values[index];
+    
+    *storage = json_number(json_number_array_get(json, index));
+    return storage;
+  }
+  
+  json_bool json_equals(JsonValue* a, JsonValue* b) {
+    if (!a || !b) return a == b;
+    if (a == b) return 1;
+    
+    if (json_is_any_number(a) && json_is_any_number(b)) {
+      return json_get_number(a) == json_get_number(b);
+    }
+    
+    if (json_is_any_array(a) && json_is_any_array(b)) {
+      uint32_t count = (a->type == JSON_ARRAY) ? a->array_value->count : a->number_array_value->count;
+      uint32_t other = (b->type == JSON_ARRAY) ? b->array_value->count : b->number_array_value->count;
+      if (count != other) return 0;
+      
+      for (uint32_t i = 0; i < count; ++i) {
+        JsonValue x, y;
+        if (!json_equals(json_any_element(a, i, &x), json_any_element(b, i, &y))) return 0;
+      }
+      
+      return 1;
+    }
+    
+    if (a->type != b->type) return 0;
+    
+    switch (a->type) {
+      case JSON_STRING: {
+        return json_strcmp(a->string_value, b->string_value) == 0;
+      }
+      
+      case JSON_BOOL: {
+        return !a->bool_value == !b->bool_value;
+      }
+      
+      case JSON_OBJECT: {
+        if (json_member_count(a) != json_member_count(b)) return 0;
+        
+        for (JsonObject* v = a->object_value; v != NULL; v = v->next) {
+          if (v->key && !json_equals(v->value, json_get_field(b, v->key))) return 0;
+        }
+        
+        return 1;
+      }
+      
+      case JSON_NULL: {
+        return 1;
+      }
+      
+      // Handled above
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER:
+      case JSON_ARRAY:
+      case JSON_NUMBER_ARRAY: {
+        break;
+      }
+    }
+    
+    return 0;
+  }
+  
+  // Decodes the reference token at the start of pointer into token (~0 is '~' and ~1 is '/'), returns where it ends
+  static const json_char* json_pointer_next(const json_char* pointer, json_char* token) {
+    uint32_t length = 0;
+    
+    for (; *pointer && *pointer != JSTR('/'); ++pointer) {
+      if (pointer[0] == JSTR('~') && pointer[1] == JSTR('0')) {
+        token[length++] = JSTR('~');
+        ++pointer;
+      } else if (pointer[0] == JSTR('~') && pointer[1] == JSTR('1')) {
+        token[length++] = JSTR('/');
+        ++pointer;
+      } else {
+        token[length++] = *pointer;
+      }
+    }
+    
+    token[length] = JSTR('\0');
+    return pointer;
+  }
+  
+  // Array index according to RFC 6901, no signs and no leading zeros
+  static int64_t json_pointer_index(const json_char* key) {
+    if (!isdigit(key[0]) || (key[0] == JSTR('0') && key[1] != JSTR('\0'))) return -1;
+    
+    int64_t index = 0;
+    for (const json_char* p = key; *p; ++p) {
+      if (!isdigit(*p) || index > (INT64_MAX / 10)) return -1;
+      index = index * 10 + (*p - JSTR('0'));
+    }
+    
+    return index;
+  }
+  
+  // Index of an array element for a patch, "-" is one past the last element
+  static json_bool json_patch_index(const json_char* token, uint32_t count, uint32_t* index) {
+    if (token[0] == JSTR('-') && token[1] == JSTR('\0')) {
+      *index = count;
+      return 1;
+    }
+    
+    int64_t value = json_pointer_index(token);
+    if (value < 0 || value > UINT32_MAX) return 0;
+    
+    *index = (uint32_t)value;
+    return 1;
+  }
+  
+  static JsonValue* json_pointer_child(JsonValue* json, const json_char* token, json_bool mut) {
+    if (json->type == JSON_OBJECT) {
+      return (mut) ? json_get_field_mut(json, token) : json_get_field(json, token);
+    }
+    
+    // Number array elements aren't JsonValues, json_pointer_parent() expands them when patching
+    if (json->type != JSON_ARRAY) return NULL;
+    
+    int64_t index = json_pointer_index(token);
+    if (index < 0 || index >= json->array_value->count) return NULL;
+    
+    return (mut) ? json_get_element_mut(json, (uint32_t)index) : &json->array_value->values[index];
+  }
+  
+  // Follows all but the last token of pointer, which is left decoded in token (at least as long as pointer).
+  // Every level along the path is made unique, NULL if the path doesn't exist
+  static JsonValue* json_pointer_parent(JsonValue* json, const json_char* pointer, json_char* token) {
+    if (pointer[0] != JSTR('/')) return NULL;
+    
+    const json_char* p = json_pointer_next(pointer + 1, token);
+    while (*p) {
+      json = json_pointer_child(json, token, 1);
+      if (!json) return NULL;
+      
+      p = json_pointer_next(p + 1, token);
+    }
+    
+    json_make_unique(json);
+    json_number_array_expand(json);
+    
     return json;
   }
   
-  inline JsonValue json_number(double value) {
-    JsonValue json  = {};
-    json.type = JSON_NUMBER;
-    json.number_value = value;
+  // Target of a patch operation, every level above it has been made unique
+  static JsonValue* json_patch_target(JsonValue* json, const json_char* pointer, json_char* token) {
+    if (pointer[0] == JSTR('\0')) return json;
+    
+    JsonValue* parent = json_pointer_parent(json, pointer, token);
+    return (parent) ? json_pointer_child(parent, token, 0) : NULL;
+  }
+  
+  // Takes ownership of value, it's freed if it can't be added
+  static json_bool json_patch_add(JsonValue* json, const json_char* pointer, JsonValue value, json_char* token) {
+    if (pointer[0] == JSTR('\0')) {
+      json_free(json);
+      *json = value;
+      return 1;
+    }
+    
+    JsonValue* parent = json_pointer_parent(json, pointer, token);
+    
+    if (parent && parent->type == JSON_OBJECT) {
+      json_set_field(parent, token, value);
+      return 1;
+    }
+    
+    if (parent && parent->type == JSON_ARRAY) {
+      uint32_t index;
+      if (json_patch_index(token, parent->array_value->count, &index) && index <= parent->array_value->count) {
+        json_array_splice(parent->array_value, index, 0, &value, 1);
+        return 1;
+      }
+    }
+    
+    json_free(&value);
+    return 0;
+  }
+  
+  // Detaches the value at pointer without freeing it
+  static json_bool json_patch_take(JsonValue* json, const json_char* pointer, JsonValue* out, json_char* token) {
+    JsonValue* parent = json_pointer_parent(json, pointer, token);
+    if (!parent) return 0;
+    
+    if (parent->type == JSON_OBJECT) {
+      JsonObject* node = json_unlink_field(parent, token);
+      if (!node) return 0;
+      
+      *out = *node->value;
+      json_free_field(parent, node);
+      return 1;
+    }
+    
+    if (parent->type == JSON_ARRAY) {
+      uint32_t index;
+      if (!json_patch_index(token, parent->array_value->count, &index) || index >= parent->array_value->count) return 0;
+      
+      *out = parent->array_value->values[index];
+      json_array_splice(parent->array_value, index, 1, NULL, 0);
+      return 1;
+    }
+    
+    return 0;
+  }
+  
+  static json_bool json_patch_operation(JsonValue* json, JsonValue* operation) {
+    JsonValue* op = json_get_field(operation, JSTR("op"));
+    JsonValue* path = json_get_field(operation, JSTR("path"));
+    JsonValue* from = json_get_field(operation, JSTR("from"));
+    JsonValue* value = json_get_field(operation, JSTR("value"));
+    
+    if (!op || op->type != JSON_STRING || !path || path->type != JSON_STRING) return 0;
+    if (from && from->type != JSON_STRING) return 0;
+    
+    size_t length = json_strlen(path->string_value);
+    if (from && json_strlen(from->string_value) > length) length = json_strlen(from->string_value);
+    
+    json_char* token = (json_char*)JSON_MALLOC((length + 1) * sizeof(json_char));
+    const json_char* name = op->string_value;
+    json_bool ok = 0;
+    
+    if (json_strcmp(name, JSTR("add")) == 0) {
+      ok = value && json_patch_add(json, path->string_value, json_duplicate(value), token);
+    } else if (json_strcmp(name, JSTR("remove")) == 0) {
+      JsonValue removed;
+      ok = json_patch_take(json, path->string_value, &removed, token);
+      if (ok) json_free(&removed);
+    } else if (json_strcmp(name, JSTR("replace")) == 0) {
+      JsonValue* target = json_patch_target(json, path->string_value, token);
+      ok = value && target;
+      if (ok) {
+        json_free(target);
+        *target = json_duplicate(value);
+      }
+    } else if (json_strcmp(name, JSTR("move")) == 0 && from) {
+      // A value can't be moved into one of its own children
+      size_t from_length = json_strlen(from->string_value);
+      json_bool into_child = json_strncmp(from->string_value, path->string_value, from_length) == 0 &&
+                             path->string_value[from_length] == JSTR('/');
+      
+      if (json_strcmp(from->string_value, path->string_value) == 0) {
+        ok = json_patch_target(json, path->string_value, token) != NULL;
+      } else if (!into_child) {
+        JsonValue moved;
+        ok = json_patch_take(json, from->string_value, &moved, token) &&
+             json_patch_add(json, path->string_value, moved, token);
+      }
+    } else if (json_strcmp(name, JSTR("copy")) == 0 && from) {
+      JsonValue* source = json_patch_target(json, from->string_value, token);
+      ok = source && json_patch_add(json, path->string_value, json_duplicate(source), token);
+    } else if (json_strcmp(name, JSTR("test")) == 0) {
+      ok = value && json_equals(json_patch_target(json, path->string_value, token), value);
+    }
+    
+    JSON_FREE(token);
+    return ok;
+  }
+  
+  json_bool json_apply_patch(JsonValue* json, JsonValue* patch) {
+    if (!json || !patch || patch->type != JSON_ARRAY) {
+      json_printf(JSTR("JSON patch must be an array of operations\n"));
+      return 0;
+    }
+    
+    for (uint32_t i = 0; i < patch->array_value->count; ++i) {
+      if (!json_patch_operation(json, &patch->array_value->values[i])) {
+        json_printf(JSTR("JSON patch operation %u failed\n"), i);
+        return 0;
+      }
+    }
+    
+    return 1;
+  }
+  
+  void json_apply_merge_patch(JsonValue* json, JsonValue* patch) {
+    if (!json || !patch) return;
+    
+    if (patch->type != JSON_OBJECT) {
+      json_free(json);
+      *json = json_duplicate(patch);
+      return;
+    }
+    
+    if (json->type != JSON_OBJECT) {
+      json_free(json);
+      *json = json_object();
+    }
+    
+    json_make_unique(json);
+    
+    for (JsonObject* field = patch->object_value; field != NULL; field = field->next) {
+      if (!field->key) continue;
+      
+      if (field->value->type == JSON_NULL) {
+        json_remove_field(json, field->key);
+        continue;
+      }
+      
+      JsonValue* target = json_get_field(json, field->key);
+      if (!target) target = json_set_field(json, field->key, json_null());
+      
+      json_apply_merge_patch(target, field->value);
+    }
+  }
+  
+  // Diffing
+  
+  // Finalizer of splitmix64
+  static inline uint64_t json_hash_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+  }
+  
+  // FNV-1a over the code units of a string
+  static uint64_t json_hash_string(const json_char* str) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const json_char* s = str; *s; ++s) {
+      hash = (hash ^ (uint64_t)(uint32_t)*s) * 1099511628211ull;
+    }
+    
+    return hash;
+  }
+  
+  static inline uint64_t json_hash_number(double value) {
+    // -0 and 0 are equal
+    if (value == 0.0) value = 0.0;
+    
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return json_hash_mix(bits ^ 0x6e756d626572ull);
+  }
+  
+  static json_bool json_hash_cache_find(JsonHashCache* cache, const void* key, uint64_t* hash) {
+    if (!cache || cache->capacity == 0) return 0;
+    
+    uint64_t epoch = json_storage_epoch_load();
+    uint32_t slot = (uint32_t)json_hash_mix((uint64_t)(uintptr_t)key) & (cache->capacity - 1);
+    for (; cache->entries[slot].key; slot = (slot + 1) & (cache->capacity - 1)) {
+      if (cache->entries[slot].key == key && cache->entries[slot].epoch == epoch) {
+        *hash = cache->entries[slot].hash;
+        return 1;
+      }
+    }
+    
+    return 0;
+  }
+  
+  static void json_hash_cache_insert(JsonHashCache* cache, const void* key, uint64_t hash) {
+    if (!cache) return;
+    
+    uint64_t epoch = json_storage_epoch_load();
+    
+    if ((cache->count + 1) * 2 > cache->capacity) {
+      // Stale entries are dropped, the table only grows if the live ones need it
+      uint32_t live = 0;
+      for (uint32_t i = 0; i < cache->capacity; ++i) {
+        if (cache->entries[i].key && cache->entries[i].epoch == epoch) ++live;
+      }
+      
+      // @HARDCODED
+      uint32_t capacity = (cache->capacity) ? cache->capacity : 64;
+      if ((live + 1) * 4 > capacity) capacity *= 2;
+      
+      JsonHashEntry* entries = (JsonHashEntry*)JSON_MALLOC(capacity * sizeof(JsonHashEntry));
+      if (!entries) return;
+      memset(entries, 0, capacity * sizeof(JsonHashEntry));
+      
+      for (uint32_t i = 0; i < cache->capacity; ++i) {
+        if (!cache->entries[i].key || cache->entries[i].epoch != epoch) continue;
+        
+        uint32_t slot = (uint32_t)json_hash_mix((uint64_t)(uintptr_t)cache->entries[i].key) & (capacity - 1);
+        while (entries[slot].key) slot = (slot + 1) & (capacity - 1);
+        entries[slot] = cache->entries[i];
+      }
+      
+      if (cache->entries) JSON_FREE(cache->entries);
+      else json_hash_caches_add(1);
+      
+      cache->entries = entries;
+      cache->capacity = capacity;
+      cache->count = live;
+    }
+    
+    // Slots never become empty again until the table is rebuilt, so taking over a stale one keeps every probe chain intact
+    uint32_t slot = (uint32_t)json_hash_mix((uint64_t)(uintptr_t)key) & (cache->capacity - 1);
+    while (cache->entries[slot].key && cache->entries[slot].epoch == epoch) slot = (slot + 1) & (cache->capacity - 1);
+    
+    if (!cache->entries[slot].key) ++cache->count;
+    cache->entries[slot].key = key;
+    cache->entries[slot].hash = hash;
+    cache->entries[slot].epoch = epoch;
+  }
+  
+  void json_hash_cache_free(JsonHashCache* cache) {
+    if (!cache) return;
+    
+    if (cache->entries) {
+      JSON_FREE(cache->entries);
+      json_hash_caches_add(-1);
+    }
+    memset(cache, 0, sizeof(JsonHashCache));
+  }
+  
+  // Storage of an array or object, NULL for everything else
+  static inline const void* json_storage(JsonValue* json) {
+    switch (json->type) {
+      case JSON_OBJECT: return json->object_value;
+      case JSON_ARRAY: return json->array_value;
+      case JSON_NUMBER_ARRAY: return json->number_array_value;
+      default: return NULL;
+    }
+  }
+  
+  // Structural hash that agrees with json_equals(): object members in any order, numbers by value
+  static uint64_t json_hash_value(JsonValue* json, JsonHashCache* cache) {
+    const void* storage = json_storage(json);
+    
+    uint64_t hash = 0;
+    if (storage && json_hash_cache_find(cache, storage, &hash)) return hash;
+    
+    switch (json->type) {
+      case JSON_NULL: {
+        return 0x6e756c6cull;
+      }
+      
+      case JSON_BOOL: {
+        return (json->bool_value) ? 0x74727565ull : 0x66616c7365ull;
+      }
+      
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER: {
+        return json_hash_number(json_get_number(json));
+      }
+      
+      case JSON_STRING: {
+        return json_hash_mix(json_hash_string(json->string_value));
+      }
+      
+      case JSON_ARRAY: {
+        hash = 0x6172726179ull;
+        for (uint32_t i = 0; i < json->array_value->count; ++i) {
+          hash = json_hash_mix(hash + json_hash_value(&json->array_value->values[i], cache));
+        }
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        // Same as the equivalent JSON_ARRAY
+        hash = 0x6172726179ull;
+        for (uint32_t i = 0; i < json->number_array_value->count; ++i) {
+          hash = json_hash_mix(hash + json_hash_number(json_number_array_get(json, i)));
+        }
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        // Summing the members makes it independent of their order
+        hash = 0x6f626a656374ull;
+        for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+          if (!v->key) continue;
+          hash += json_hash_mix(json_hash_string(v->key) * 31 + json_hash_value(v->value, cache));
+        }
+        hash = json_hash_mix(hash);
+        break;
+      }
+    }
+    
+    if (storage) json_hash_cache_insert(cache, storage, hash);
+    return hash;
+  }
+  
+  uint64_t json_hash(JsonValue* json, JsonHashCache* cache) {
+    if (!json) return 0;
+    return json_hash_value(json, cache);
+  }
+  
+  // Open addressing index of an object's members, only built for objects where a linear search would add up
+  typedef struct {
+    JsonObject** slots;
+    uint32_t capacity;
+  } JsonMemberIndex;
+  
+  static void json_member_index_build(JsonMemberIndex* index, JsonValue* json) {
+    // @HARDCODED
+    const uint32_t MIN_INDEXED_MEMBERS = 16;
+    
+    index->slots = NULL;
+    index->capacity = 0;
+    
+    uint32_t count = json_member_count(json);
+    if (count < MIN_INDEXED_MEMBERS) return;
+    
+    uint32_t capacity = 1;
+    while (capacity < count * 2) capacity *= 2;
+    
+    JsonObject** slots = (JsonObject**)JSON_MALLOC(capacity * sizeof(JsonObject*));
+    if (!slots) return;
+    memset(slots, 0, capacity * sizeof(JsonObject*));
+    
+    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
+      if (!v->key) continue;
+      
+      // The first of duplicate keys wins, like json_get_field()
+      uint32_t slot = v->key_hash & (capacity - 1);
+      json_bool duplicate = 0;
+      for (; slots[slot]; slot = (slot + 1) & (capacity - 1)) {
+        if (slots[slot]->key_hash == v->key_hash && json_strcmp(slots[slot]->key, v->key) == 0) {
+          duplicate = 1;
+          break;
+        }
+      }
+      
+      if (!duplicate) slots[slot] = v;
+    }
+    
+    index->slots = slots;
+    index->capacity = capacity;
+  }
+  
+  static JsonValue* json_member_index_find(JsonMemberIndex* index, JsonValue* json, JsonObject* member) {
+    if (!index->slots) return json_get_field(json, member->key);
+    
+    uint32_t slot = member->key_hash & (index->capacity - 1);
+    for (; index->slots[slot]; slot = (slot + 1) & (index->capacity - 1)) {
+      JsonObject* v = index->slots[slot];
+      if (v->key_hash == member->key_hash && json_strcmp(v->key, member->key) == 0) return v->value;
+    }
+    
+    return NULL;
+  }
+  
+  static void json_member_index_free(JsonMemberIndex* index) {
+    if (index->slots) JSON_FREE(index->slots);
+  }
+  
+  typedef struct {
+    JsonDiffCallback callback;
+    void* user;
+    
+    uint32_t changes;
+    json_bool stopped;
+    
+    // Pointer to the value being compared
+    json_char* path;
+    uint32_t path_length;
+    uint32_t path_capacity;
+    
+    JsonHashCache hashes;
+  } JsonDiff;
+  
+  static void json_diff_emit(JsonDiff* d, JsonDiffOp op, JsonValue* value) {
+    if (d->stopped) return;
+    
+    ++d->changes;
+    if (!d->callback(d->user, op, (d->path) ? d->path : JSTR(""), value)) d->stopped = 1;
+  }
+  
+  // Appends /token to the path, escaping ~ and /, returns the previous length to pop it again
+  static uint32_t json_diff_push(JsonDiff* d, const json_char* token) {
+    uint32_t previous = d->path_length;
+    uint32_t needed = d->path_length + 2 + 2 * (uint32_t)json_strlen(token);
+    
+    if (needed > d->path_capacity) {
+      uint32_t capacity = (d->path_capacity) ? d->path_capacity : 64;
+      while (capacity < needed) capacity *= 2;
+      
+      json_char* path = (json_char*)JSON_REALLOC(d->path, capacity * sizeof(json_char));
+      if (!path) {
+        d->stopped = 1;
+        return previous;
+      }
+      
+      d->path = path;
+      d->path_capacity = capacity;
+    }
+    
+    d->path[d->path_length++] = JSTR('/');
+    for (const json_char* t = token; *t; ++t) {
+      if (*t == JSTR('~')) {
+        d->path[d->path_length++] = JSTR('~');
+        d->path[d->path_length++] = JSTR('0');
+      } else if (*t == JSTR('/')) {
+        d->path[d->path_length++] = JSTR('~');
+        d->path[d->path_length++] = JSTR('1');
+      } else {
+        d->path[d->path_length++] = *t;
+      }
+    }
+    d->path[d->path_length] = JSTR('\0');
+    
+    return previous;
+  }
+  
+  static uint32_t json_diff_push_index(JsonDiff* d, uint32_t index) {
+    json_char token[16];
+    json_sprintf(token, 16, JSTR("%u"), index);
+    return json_diff_push(d, token);
+  }
+  
+  static void json_diff_pop(JsonDiff* d, uint32_t length) {
+    d->path_length = length;
+    if (d->path) d->path[length] = JSTR('\0');
+  }
+  
+  static void json_diff_value(JsonDiff* d, JsonValue* a, JsonValue* b);
+  
+  static void json_diff_object(JsonDiff* d, JsonValue* a, JsonValue* b) {
+    JsonMemberIndex a_index, b_index;
+    json_member_index_build(&a_index, a);
+    json_member_index_build(&b_index, b);
+    
+    for (JsonObject* v = a->object_value; v != NULL && !d->stopped; v = v->next) {
+      if (!v->key) continue;
+      
+      JsonValue* other = json_member_index_find(&b_index, b, v);
+      uint32_t length = json_diff_push(d, v->key);
+      
+      if (other) json_diff_value(d, v->value, other);
+      else json_diff_emit(d, JSON_DIFF_REMOVE, NULL);
+      
+      json_diff_pop(d, length);
+    }
+    
+    for (JsonObject* v = b->object_value; v != NULL && !d->stopped; v = v->next) {
+      if (!v->key || json_member_index_find(&a_index, a, v)) continue;
+      
+      uint32_t length = json_diff_push(d, v->key);
+      json_diff_emit(d, JSON_DIFF_ADD, v->value);
+      json_diff_pop(d, length);
+    }
+    
+    json_member_index_free(&a_index);
+    json_member_index_free(&b_index);
+  }
+  
+  static inline uint32_t json_any_count(JsonValue* json) {
+    return (json->type == JSON_ARRAY) ? json->array_value->count : json->number_array_value->count;
+  }
+  
+  // Turns the unmatched elements a[a_start, a_end) into b[b_start, b_end), a_start is still their index in the document
+  static void json_diff_gap(JsonDiff* d, JsonValue* a, uint32_t a_start, uint32_t a_end,
+                            JsonValue* b, uint32_t b_start, uint32_t b_end) {
+    uint32_t a_count = a_end - a_start;
+    uint32_t b_count = b_end - b_start;
+    uint32_t pairs = (a_count < b_count) ? a_count : b_count;
+    
+    // Elements that took each other's place are compared, the rest is removed or added
+    for (uint32_t k = 0; k < pairs && !d->stopped; ++k) {
+      JsonValue x, y;
+      uint32_t length = json_diff_push_index(d, a_start + k);
+      json_diff_value(d, json_any_element(a, a_start + k, &x), json_any_element(b, b_start + k, &y));
+      json_diff_pop(d, length);
+    }
+    
+    // Back to front so the indices stay valid
+    for (uint32_t k = a_count; k > pairs && !d->stopped; --k) {
+      uint32_t length = json_diff_push_index(d, a_start + k - 1);
+      json_diff_emit(d, JSON_DIFF_REMOVE, NULL);
+      json_diff_pop(d, length);
+    }
+    
+    for (uint32_t k = pairs; k < b_count && !d->stopped; ++k) {
+      JsonValue y;
+      uint32_t length = json_diff_push_index(d, a_start + k);
+      json_diff_emit(d, JSON_DIFF_ADD, json_any_element(b, b_start + k, &y));
+      json_diff_pop(d, length);
+    }
+  }
+  
+  // Equal hashes are confirmed, a collision must not drop a change from the patch
+  static json_bool json_diff_same_element(JsonValue* a, uint32_t i, JsonValue* b, uint32_t j) {
+    JsonValue x, y;
+    return json_equals(json_any_element(a, i, &x), json_any_element(b, j, &y));
+  }
+  
+  static void json_diff_array(JsonDiff* d, JsonValue* a, JsonValue* b) {
+    // @HARDCODED: largest LCS table, bigger changes compare the remaining elements by position
+    const uint64_t MAX_LCS_CELLS = 1 << 22;
+    
+    uint32_t a_count = json_any_count(a);
+    uint32_t b_count = json_any_count(b);
+    
+    uint64_t* a_hashes = (uint64_t*)JSON_MALLOC(((size_t)a_count + b_count + 1) * sizeof(uint64_t));
+    if (!a_hashes) {
+      d->stopped = 1;
+      return;
+    }
+    uint64_t* b_hashes = a_hashes + a_count;
+    
+    for (uint32_t i = 0; i < a_count; ++i) {
+      JsonValue x;
+      a_hashes[i] = json_hash_value(json_any_element(a, i, &x), &d->hashes);
+    }
+    for (uint32_t i = 0; i < b_count; ++i) {
+      JsonValue y;
+      b_hashes[i] = json_hash_value(json_any_element(b, i, &y), &d->hashes);
+    }
+    
+    // Skip the common prefix and suffix, usually all that differs is in between
+    uint32_t prefix = 0;
+    while (prefix < a_count && prefix < b_count && a_hashes[prefix] == b_hashes[prefix] &&
+           json_diff_same_element(a, prefix, b, prefix)) ++prefix;
+    
+    uint32_t suffix = 0;
+    while (suffix < a_count - prefix && suffix < b_count - prefix &&
+           a_hashes[a_count - suffix - 1] == b_hashes[b_count - suffix - 1] &&
+           json_diff_same_element(a, a_count - suffix - 1, b, b_count - suffix - 1)) ++suffix;
+    
+    uint32_t n = a_count - prefix - suffix;
+    uint32_t m = b_count - prefix - suffix;
+    
+    // table[i * (m + 1) + j] is the length of the LCS of a[prefix + i..] and b[prefix + j..]
+    uint32_t* table = NULL;
+    if (n > 0 && m > 0 && (uint64_t)(n + 1) * (m + 1) <= MAX_LCS_CELLS) {
+      table = (uint32_t*)JSON_MALLOC((size_t)(n + 1) * (m + 1) * sizeof(uint32_t));
+    }
+    
+    if (table) {
+      uint32_t w = m + 1;
+      for (uint32_t j = 0; j <= m; ++j) table[n * w + j] = 0;
+      
+      for (uint32_t i = n; i-- > 0;) {
+        table[i * w + m] = 0;
+        
+        for (uint32_t j = m; j-- > 0;) {
+          if (a_hashes[prefix + i] == b_hashes[prefix + j]) {
+            table[i * w + j] = table[(i + 1) * w + j + 1] + 1;
+          } else {
+            uint32_t down = table[(i + 1) * w + j];
+            uint32_t right = table[i * w + j + 1];
+            table[i * w + j] = (down > right) ? down : right;
+          }
+        }
+      }
+      
+      // Collect the matches front to back, then fill the gaps between them back to front
+      uint32_t matches = table[0];
+      uint32_t* pairs = (uint32_t*)JSON_MALLOC(((size_t)matches * 2 + 1) * sizeof(uint32_t));
+      
+      if (pairs) {
+        // A pair whose hashes collide isn't taken, the elements end up in a gap and are compared there
+        uint32_t i = 0, j = 0, k = 0;
+        while (i < n && j < m) {
+          if (a_hashes[prefix + i] == b_hashes[prefix + j] && json_diff_same_element(a, prefix + i, b, prefix + j)) {
+            pairs[k * 2] = i++;
+            pairs[k * 2 + 1] = j++;
+            ++k;
+          } else if (table[(i + 1) * w + j] >= table[i * w + j + 1]) {
+            ++i;
+          } else {
+            ++j;
+          }
+        }
+        
+        matches = k;
+        
+        uint32_t a_end = n, b_end = m;
+        for (k = matches; k > 0 && !d->stopped; --k) {
+          uint32_t a_match = pairs[(k - 1) * 2];
+          uint32_t b_match = pairs[(k - 1) * 2 + 1];
+          
+          json_diff_gap(d, a, prefix + a_match + 1, prefix + a_end, b, prefix + b_match + 1, prefix + b_end);
+          
+          a_end = a_match;
+          b_end = b_match;
+        }
+        
+        json_diff_gap(d, a, prefix, prefix + a_end, b, prefix, prefix + b_end);
+        JSON_FREE(pairs);
+      } else {
+        d->stopped = 1;
+      }
+      
+      JSON_FREE(table);
+    } else {
+      json_diff_gap(d, a, prefix, prefix + n, b, prefix, prefix + m);
+    }
+    
+    JSON_FREE(a_hashes);
+  }
+  
+  static void json_diff_value(JsonDiff* d, JsonValue* a, JsonValue* b) {
+    if (d->stopped) return;
+    
+    // Scalars are cheap to compare exactly
+    if ((a->type != JSON_OBJECT && !json_is_any_array(a)) || (b->type != JSON_OBJECT && !json_is_any_array(b))) {
+      if (!json_equals(a, b)) json_diff_emit(d, JSON_DIFF_REPLACE, b);
+      return;
+    }
+    
+    // Shared or identical subtrees end the walk, hashes are cached so each subtree is hashed once
+    const void* storage = json_storage(a);
+    if (storage && storage == json_storage(b)) return;
+    if (json_hash_value(a, &d->hashes) == json_hash_value(b, &d->hashes) && json_equals(a, b)) return;
+    
+    if (a->type == JSON_OBJECT && b->type == JSON_OBJECT) {
+      json_diff_object(d, a, b);
+    } else if (json_is_any_array(a) && json_is_any_array(b)) {
+      json_diff_array(d, a, b);
+    } else {
+      json_diff_emit(d, JSON_DIFF_REPLACE, b);
+    }
+  }
+  
+  uint32_t json_diff_each(JsonValue* from, JsonValue* to, JsonDiffCallback callback, void* user) {
+    if (!from || !to || !callback) return 0;
+    
+    JsonDiff d = {};
+    d.callback = callback;
+    d.user = user;
+    
+    json_diff_value(&d, from, to);
+    
+    if (d.path) JSON_FREE(d.path);
+    json_hash_cache_free(&d.hashes);
+    
+    return d.changes;
+  }
+  
+  static json_bool json_diff_append(void* user, JsonDiffOp op, const json_char* path, JsonValue* value) {
+    static const json_char* names[] = { JSTR("add"), JSTR("remove"), JSTR("replace") };
+    
+    JsonValue operation = json_object();
+    json_add_field(&operation, JSTR("op"), json_string(names[op]));
+    json_add_field(&operation, JSTR("path"), json_string(path));
+    if (value) json_add_field(&operation, JSTR("value"), json_duplicate(value));
+    
+    json_add_element((JsonValue*)user, operation);
+    return 1;
+  }
+  
+  JsonValue json_diff(JsonValue* from, JsonValue* to) {
+    JsonValue patch = json_array();
+    json_diff_each(from, to, json_diff_append, &patch);
+    
+    return patch;
+  }
+  
+  // CBOR
+  
+  // Major types
+  enum {
+    JSON_CBOR_UINT = 0,
+    JSON_CBOR_NINT = 1,
+    JSON_CBOR_BYTES = 2,
+    JSON_CBOR_TEXT = 3,
+    JSON_CBOR_ARRAY = 4,
+    JSON_CBOR_MAP = 5,
+    JSON_CBOR_TAG = 6,
+    JSON_CBOR_SIMPLE = 7
+  };
+  
+  // Tag for "embedded CBOR data item", used to wrap sized containers
+  static const uint64_t JSON_CBOR_TAG_EMBEDDED = 24;
+  
+  static uint8_t* json_cbor_reserve(JsonCborWriter* w, uint64_t count) {
+    if (w->failed) return NULL;
+    
+    if (w->size + count > w->capacity) {
+      if (w->flush && w->open_sized == 0 && w->size > 0) {
+        json_cbor_writer_flush(w);
+        if (w->failed) return NULL;
+      }
+      
+      if (w->size + count > w->capacity) {
+        uint64_t capacity = (w->capacity) ? w->capacity : JSON_CBOR_FLUSH_SIZE;
+        while (capacity < w->size + count) capacity *= 2;
+        
+        uint8_t* data = (uint8_t*)JSON_REALLOC(w->data, (size_t)capacity);
+        if (!data) {
+          w->failed = 1;
+          return NULL;
+        }
+        
+        w->data = data;
+        w->capacity = capacity;
+      }
+    }
+    
+    uint8_t* ptr = w->data + w->size;
+    w->size += count;
+    return ptr;
+  }
+  
+  static void json_cbor_write_head(JsonCborWriter* w, uint8_t major, uint64_t arg) {
+    major <<= 5;
+    
+    if (arg < 24) {
+      uint8_t* out = json_cbor_reserve(w, 1);
+      if (out) out[0] = major | (uint8_t)arg;
+    } else if (arg <= UINT8_MAX) {
+      uint8_t* out = json_cbor_reserve(w, 2);
+      if (out) {
+        out[0] = major | 24;
+        out[1] = (uint8_t)arg;
+      }
+    } else if (arg <= UINT16_MAX) {
+      uint8_t* out = json_cbor_reserve(w, 3);
+      if (out) {
+        out[0] = major | 25;
+        out[1] = (uint8_t)(arg >> 8);
+        out[2] = (uint8_t)arg;
+      }
+    } else if (arg <= UINT32_MAX) {
+      uint8_t* out = json_cbor_reserve(w, 5);
+      if (out) {
+        out[0] = major | 26;
+        for (int i = 0; i < 4; ++i) out[1 + i] = (uint8_t)(arg >> (24 - i * 8));
+      }
+    } else {
+      uint8_t* out = json_cbor_reserve(w, 9);
+      if (out) {
+        out[0] = major | 27;
+        for (int i = 0; i < 8; ++i) out[1 + i] = (uint8_t)(arg >> (56 - i * 8));
+      }
+    }
+  }
+  
+  void json_cbor_writer_init(JsonCborWriter* writer, JsonCborFlush flush, void* user) {
+    memset(writer, 0, sizeof(JsonCborWriter));
+    writer->flush = flush;
+    writer->user = user;
+  }
+  
+  json_bool json_cbor_writer_flush(JsonCborWriter* writer) {
+    if (writer->failed) return 0;
+    if (!writer->flush || writer->size == 0) return 1;
+    
+    // Sized containers are patched in place, they can't be flushed until they're closed
+    if (writer->open_sized > 0) return 1;
+    
+    if (!writer->flush(writer->user, writer->data, writer->size)) {
+      writer->failed = 1;
+      return 0;
+    }
+    
+    writer->size = 0;
+    return 1;
+  }
+  
+  void json_cbor_writer_free(JsonCborWriter* writer) {
+    if (writer->data) JSON_FREE(writer->data);
+    memset(writer, 0, sizeof(JsonCborWriter));
+  }
+  
+  void json_cbor_write_null(JsonCborWriter* writer) {
+    json_cbor_write_head(writer, JSON_CBOR_SIMPLE, 22);
+  }
+  
+  void json_cbor_write_bool(JsonCborWriter* writer, json_bool value) {
+    json_cbor_write_head(writer, JSON_CBOR_SIMPLE, (value) ? 21 : 20);
+  }
+  
+  void json_cbor_write_number(JsonCborWriter* writer, double value) {
+    // Write integers in their shortest form
+    if (fmod(value, 1.0) == 0.0 && value >= -9223372036854775808.0 && value < 9223372036854775808.0) {
+      int64_t integer = (int64_t)value;
+      
+      // Keep the sign of -0.0
+      if (integer != 0 || !signbit(value)) {
+        if (integer >= 0) {
+          json_cbor_write_head(writer, JSON_CBOR_UINT, (uint64_t)integer);
+        } else {
+          json_cbor_write_head(writer, JSON_CBOR_NINT, (uint64_t)(-(integer + 1)));
+        }
+        return;
+      }
+    }
+    
+    float single = (float)value;
+    if ((double)single == value || value != value) {
+      uint32_t bits;
+      memcpy(&bits, &single, sizeof(bits));
+      
+      uint8_t* out = json_cbor_reserve(writer, 5);
+      if (out) {
+        out[0] = (JSON_CBOR_SIMPLE << 5) | 26;
+        for (int i = 0; i < 4; ++i) out[1 + i] = (uint8_t)(bits >> (24 - i * 8));
+      }
+    } else {
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      
+      uint8_t* out = json_cbor_reserve(writer, 9);
+      if (out) {
+        out[0] = (JSON_CBOR_SIMPLE << 5) | 27;
+        for (int i = 0; i < 8; ++i) out[1 + i] = (uint8_t)(bits >> (56 - i * 8));
+      }
+    }
+  }
+  
+  void json_cbor_write_string(JsonCborWriter* writer, const json_char* value) {
+#ifdef JSON_USE_SINGLE_BYTE
+    uint64_t length = json_strlen(value);
+    
+    json_cbor_write_head(writer, JSON_CBOR_TEXT, length);
+    uint8_t* out = json_cbor_reserve(writer, length);
+    if (out) memcpy(out, value, (size_t)length);
+#else
+    // Measure the UTF-8 length first so the header can be written up front
+    uint8_t tmp[4];
+    uint64_t length = 0;
+    for (const json_char* s = value; *s;) {
+      length += json_utf8_encode(json_next_codepoint(&s), tmp);
+    }
+    
+    json_cbor_write_head(writer, JSON_CBOR_TEXT, length);
+    uint8_t* out = json_cbor_reserve(writer, length);
+    if (!out) return;
+    
+    for (const json_char* s = value; *s;) {
+      out += json_utf8_encode(json_next_codepoint(&s), out);
+    }
+#endif
+  }
+  
+  void json_cbor_write_array(JsonCborWriter* writer, uint64_t count) {
+    json_cbor_write_head(writer, JSON_CBOR_ARRAY, count);
+  }
+  
+  void json_cbor_write_object(JsonCborWriter* writer, uint64_t count) {
+    json_cbor_write_head(writer, JSON_CBOR_MAP, count);
+  }
+  
+  // Writes the header of a sized container and returns the offset of its length to patch later
+  static uint64_t json_cbor_begin_sized(JsonCborWriter* w) {
+    json_cbor_write_head(w, JSON_CBOR_TAG, JSON_CBOR_TAG_EMBEDDED);
+    
+    // Always use the 8-byte length so we don't have to move the contents afterwards
+    uint8_t* out = json_cbor_reserve(w, 9);
+    if (!out) return 0;
+    
+    out[0] = (JSON_CBOR_BYTES << 5) | 27;
+    ++w->open_sized;
+    
+    return w->size;
+  }
+  
+  static void json_cbor_end_sized(JsonCborWriter* w, uint64_t start) {
+    if (w->failed) return;
+    
+    uint64_t length = w->size - start;
+    for (int i = 0; i < 8; ++i) {
+      w->data[start - 8 + i] = (uint8_t)(length >> (56 - i * 8));
+    }
+    
+    --w->open_sized;
+  }
+  
+  json_bool json_cbor_encode(JsonValue* json, JsonCborWriter* writer) {
+    if (!json || !writer) return 0;
+    
+    switch (json->type) {
+      case JSON_NULL: {
+        json_cbor_write_null(writer);
+        break;
+      }
+      
+      case JSON_STRING: {
+        json_cbor_write_string(writer, json->string_value);
+        break;
+      }
+      
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER: {
+        json_cbor_write_number(writer, json_get_number(json));
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        uint64_t count = 0;
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          if (obj->key) ++count;
+        }
+        
+        uint64_t start = (writer->sized_containers) ? json_cbor_begin_sized(writer) : 0;
+        
+        json_cbor_write_object(writer, count);
+        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          json_cbor_write_string(writer, obj->key);
+          json_cbor_encode(obj->value, writer);
+        }
+        
+        if (writer->sized_containers) json_cbor_end_sized(writer, start);
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        uint64_t start = (writer->sized_containers) ? json_cbor_begin_sized(writer) : 0;
+        
+        json_cbor_write_array(writer, json->array_value->count);
+        for (int i = 0; i < (int)json->array_value->count; ++i) {
+          json_cbor_encode(&json->array_value->values[i], writer);
+        }
+        
+        if (writer->sized_containers) json_cbor_end_sized(writer, start);
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        uint64_t start = (writer->sized_containers) ? json_cbor_begin_sized(writer) : 0;
+        
+        json_cbor_write_array(writer, json->number_array_value->count);
+        for (uint32_t i = 0; i < json->number_array_value->count; ++i) {
+          json_cbor_write_number(writer, json_number_array_get(json, i));
+        }
+        
+        if (writer->sized_containers) json_cbor_end_sized(writer, start);
+        break;
+      }
+      
+      case JSON_BOOL: {
+        json_cbor_write_bool(writer, json->bool_value);
+        break;
+      }
+    }
+    
+    if (writer->open_sized == 0 && writer->flush && writer->size >= JSON_CBOR_FLUSH_SIZE) {
+      json_cbor_writer_flush(writer);
+    }
+    
+    return !writer->failed;
+  }
+  
+  void json_cbor_reader_init(JsonCborReader* reader, const uint8_t* data, uint64_t size) {
+    reader->data = data;
+    reader->size = size;
+    reader->curr = 0;
+    reader->depth = 0;
+  }
+  
+  static json_bool json_cbor_read_head(JsonCborReader* r, uint8_t* major, uint8_t* info, uint64_t* arg) {
+    if (r->curr >= r->size) return 0;
     
-    return json;
+    uint8_t b = r->data[r->curr++];
+    *major = b >> 5;
+    *info = b & 0x1F;
+    
+    if (*info < 24) {
+      *arg = *info;
+      return 1;
+    }
+    
+    if (*info == 31) {
+      // Indefinite length or break, the caller checks info, there's no length to read
+      *arg = 0;
+      return 1;
+    }
+    
+    if (*info > 27) return 0;
+    
+    uint32_t bytes = 1u << (*info - 24);
+    if (r->curr + bytes > r->size) return 0;
+    
+    *arg = 0;
+    for (uint32_t i = 0; i < bytes; ++i) {
+      *arg = (*arg << 8) | r->data[r->curr++];
+    }
+    
+    return 1;
   }
   
-  inline JsonValue json_string(const json_char* value) {
-    JsonValue json  = {};
-    json.type = JSON_STRING;
-    json.string_value = (json_char*)json_alloc(((uint32_t)json_strlen(value) + 1) * sizeof(json_char));
-    json_strcpy(json.string_value, value);
+  static double json_cbor_half_to_double(uint16_t half) {
+    int exp = (half >> 10) & 0x1F;
+    int mant = half & 0x3FF;
+    
+    double value;
+    if (exp == 0) value = ldexp(mant, -24);
+    else if (exp != 31) value = ldexp(mant + 1024, exp - 25);
+    else value = (mant == 0) ? INFINITY : NAN;
+    
+    return (half & 0x8000) ? -value : value;
+  }
+  
+  json_bool json_cbor_read(JsonCborReader* reader, JsonCborItem* item) {
+    memset(item, 0, sizeof(JsonCborItem));
+    
+    uint8_t major, info;
+    uint64_t arg;
+    
+    for (;;) {
+      if (!json_cbor_read_head(reader, &major, &info, &arg)) return 0;
+      if (major != JSON_CBOR_TAG) break;
+      if (info == 31) return 0;
+      
+      // Sized containers are transparent to the reader, skip the byte string header
+      if (arg == JSON_CBOR_TAG_EMBEDDED) {
+        uint8_t inner_major, inner_info;
+        uint64_t inner_arg;
+        if (!json_cbor_read_head(reader, &inner_major, &inner_info, &inner_arg) ||
+            inner_major != JSON_CBOR_BYTES || inner_info == 31) {
+          return 0;
+        }
+      }
+      
+      // Other tags are ignored
+    }
+    
+    switch (major) {
+      case JSON_CBOR_UINT: {
+        if (info == 31) return 0;
+        
+        item->type = JSON_NUMBER;
+        item->number_value = (double)arg;
+        return 1;
+      }
+      
+      case JSON_CBOR_NINT: {
+        if (info == 31) return 0;
+        
+        item->type = JSON_NUMBER;
+        item->number_value = -1.0 - (double)arg;
+        return 1;
+      }
+      
+      case JSON_CBOR_BYTES:
+      case JSON_CBOR_TEXT: {
+        // Chunked strings aren't supported
+        if (info == 31 || arg > reader->size - reader->curr) return 0;
+        
+        item->type = JSON_STRING;
+        item->count = arg;
+        item->string_data = reader->data + reader->curr;
+        reader->curr += arg;
+        return 1;
+      }
+      
+      case JSON_CBOR_ARRAY: {
+        item->type = JSON_ARRAY;
+        item->count = arg;
+        item->indefinite = (info == 31);
+        return 1;
+      }
+      
+      case JSON_CBOR_MAP: {
+        item->type = JSON_OBJECT;
+        item->count = arg;
+        item->indefinite = (info == 31);
+        return 1;
+      }
+      
+      case JSON_CBOR_SIMPLE: {
+        switch (info) {
+          case 20:
+          case 21: {
+            item->type = JSON_BOOL;
+            item->bool_value = (info == 21);
+            return 1;
+          }
+          
+          case 22:
+          case 23: {
+            item->type = JSON_NULL;
+            return 1;
+          }
+          
+          case 25: {
+            item->type = JSON_NUMBER;
+            item->number_value = json_cbor_half_to_double((uint16_t)arg);
+            return 1;
+          }
+          
+          case 26: {
+            uint32_t bits = (uint32_t)arg;
+            float single;
+            memcpy(&single, &bits, sizeof(single));
+            
+            item->type = JSON_NUMBER;
+            item->number_value = single;
+            return 1;
+          }
+          
+          case 27: {
+            item->type = JSON_NUMBER;
+            memcpy(&item->number_value, &arg, sizeof(double));
+            return 1;
+          }
+        }
+        
+        return 0;
+      }
+    }
+    
+    return 0;
+  }
+  
+  json_bool json_cbor_read_break(JsonCborReader* reader) {
+    if (reader->curr < reader->size && reader->data[reader->curr] == 0xFF) {
+      ++reader->curr;
+      return 1;
+    }
+    
+    return 0;
+  }
+  
+  json_bool json_cbor_skip(JsonCborReader* reader) {
+    if (reader->curr >= reader->size) return 0;
+    
+    // Sized containers can be skipped without looking inside
+    uint64_t start = reader->curr;
+    uint8_t major, info;
+    uint64_t arg;
+    if (!json_cbor_read_head(reader, &major, &info, &arg)) return 0;
+    
+    if (major == JSON_CBOR_TAG && arg == JSON_CBOR_TAG_EMBEDDED) {
+      if (!json_cbor_read_head(reader, &major, &info, &arg) ||
+          major != JSON_CBOR_BYTES || info == 31 ||
+          arg > reader->size - reader->curr) {
+        return 0;
+      }
+      
+      reader->curr += arg;
+      return 1;
+    }
+    
+    reader->curr = start;
+    
+    JsonCborItem item;
+    if (!json_cbor_read(reader, &item)) return 0;
+    
+    if (item.type == JSON_ARRAY || item.type == JSON_OBJECT) {
+      if (reader->depth >= JSON_CBOR_MAX_DEPTH) return 0;
+      
+      // The reader stays usable after a failed skip
+      uint32_t depth = reader->depth++;
+      uint64_t entries = (item.type == JSON_OBJECT) ? 2 : 1;
+      json_bool ok = 1;
+      
+      if (item.indefinite) {
+        while (ok && !json_cbor_read_break(reader)) {
+          for (uint64_t i = 0; ok && i < entries; ++i) ok = json_cbor_skip(reader);
+        }
+      } else {
+        for (uint64_t i = 0; ok && i < item.count; ++i) {
+          for (uint64_t j = 0; ok && j < entries; ++j) ok = json_cbor_skip(reader);
+        }
+      }
+      
+      reader->depth = depth;
+      return ok;
+    }
+    
+    return 1;
+  }
+  
+  static json_char* json_cbor_decode_string(const uint8_t* data, uint64_t size) {
+#ifdef JSON_USE_SINGLE_BYTE
+    json_char* str = (json_char*)json_alloc_raw(((uint32_t)size + 1) * sizeof(json_char));
+    memcpy(str, data, (size_t)size);
+    str[size] = JSTR('\0');
+#else
+    // Never more code units than bytes, even with surrogate pairs
+    json_char* str = (json_char*)json_alloc_raw(((uint32_t)size + 1) * sizeof(json_char));
+    
+    uint64_t len = 0;
+    for (uint64_t i = 0; i < size;) {
+      uint32_t cp = json_utf8_decode(data, size, &i);
+      
+      if (sizeof(json_char) == 2 && cp > 0xFFFF) {
+        cp -= 0x10000;
+        str[len++] = (json_char)(0xD800 + (cp >> 10));
+        str[len++] = (json_char)(0xDC00 + (cp & 0x3FF));
+      } else {
+        str[len++] = (json_char)cp;
+      }
+    }
+    str[len] = JSTR('\0');
+#endif
+    
+    return str;
+  }
+  
+  static json_bool json_cbor_decode_value(JsonCborReader* r, JsonValue* value) {
+    JsonCborItem item;
+    if (!json_cbor_read(r, &item)) return 0;
+    
+    // Untrusted input could nest deep enough to overflow the stack
+    if ((item.type == JSON_ARRAY || item.type == JSON_OBJECT) && r->depth >= JSON_CBOR_MAX_DEPTH) return 0;
+    
+    switch (item.type) {
+      case JSON_NULL: {
+        *value = json_null();
+        return 1;
+      }
+      
+      case JSON_BOOL: {
+        *value = json_boolean(item.bool_value);
+        return 1;
+      }
+      
+      case JSON_NUMBER: {
+        *value = json_number(item.number_value);
+        return 1;
+      }
+      
+      case JSON_STRING: {
+        value->type = JSON_STRING;
+        value->string_value = json_cbor_decode_string(item.string_data, item.count);
+        return 1;
+      }
+      
+      case JSON_ARRAY: {
+        *value = json_array();
+        
+        JsonArray* arr = value->array_value;
+        if (!item.indefinite && item.count > 0) {
+          // Every element is at least one byte
+          if (item.count > r->size - r->curr) return 0;
+          
+          arr->capacity = (uint32_t)item.count;
+          arr->values = (JsonValue*)json_alloc_raw(sizeof(JsonValue) * arr->capacity);
+        }
+        
+        ++r->depth;
+        for (uint64_t i = 0; item.indefinite || i < item.count; ++i) {
+          if (item.indefinite && json_cbor_read_break(r)) break;
+          
+          JsonValue element = json_null();
+          if (!json_cbor_decode_value(r, &element)) {
+            json_free(&element);
+            return 0;
+          }
+          
+          json_add_element(value, element);
+        }
+        --r->depth;
+        
+        return 1;
+      }
+      
+      case JSON_OBJECT: {
+        *value = json_object();
+        
+        JsonObject* tail = NULL;
+        ++r->depth;
+        for (uint64_t i = 0; item.indefinite || i < item.count; ++i) {
+          if (item.indefinite && json_cbor_read_break(r)) break;
+          
+          JsonCborItem key;
+          if (!json_cbor_read(r, &key) || key.type != JSON_STRING) return 0;
+          
+          JsonObject* node = (JsonObject*)json_alloc(sizeof(JsonObject));
+          node->key = json_cbor_decode_string(key.string_data, key.count);
+          node->key_hash = json_hash_key(node->key, NULL);
+          node->value = (JsonValue*)json_alloc(sizeof(JsonValue));
+          
+          // Link before decoding so json_free() can clean up on failure
+          if (tail) tail->next = node;
+          else value->object_value = node;
+          tail = node;
+          
+          if (!json_cbor_decode_value(r, node->value)) return 0;
+        }
+        --r->depth;
+        
+        return 1;
+      }
+      
+      case JSON_RAW_NUMBER:
+      case JSON_NUMBER_ARRAY: {
+        // json_cbor_read() never produces these
+        break;
+      }
+    }
+    
+    return 0;
+  }
+  
+  JsonValue json_cbor_decode(const uint8_t* data, uint64_t size) {
+    JsonCborReader r;
+    json_cbor_reader_init(&r, data, size);
+    
+    JsonValue value = json_null();
+    if (!json_cbor_decode_value(&r, &value)) {
+      json_printf(JSTR("Invalid CBOR data at byte %d\n"), (int)r.curr);
+      json_free(&value);
+    }
+    
+    return value;
+  }
+  
+  // Snapshots
+  
+#define JSON_SNAPSHOT_MAGIC 0x504E534Au // "JSNP"
+#define JSON_SNAPSHOT_VERSION 1
+#define JSON_SNAPSHOT_ENDIAN 0x01020304u
+  
+  typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t endian;
+    uint32_t char_size;
+    uint64_t size;
+    JsonSnapshotNode root;
+  } JsonSnapshotHeader;
+  
+  typedef struct {
+    uint8_t* data;
+    uint64_t size;
+    uint64_t capacity;
+    json_bool failed;
+  } JsonSnapshotBuilder;
+  
+  // Returns the offset of a zeroed, 8-byte aligned block
+  static uint64_t json_snapshot_reserve(JsonSnapshotBuilder* b, uint64_t count) {
+    if (b->failed) return 0;
+    
+    count = (count + 7) & ~(uint64_t)7;
+    
+    if (b->size + count > b->capacity) {
+      uint64_t capacity = (b->capacity) ? b->capacity : 4096;
+      while (capacity < b->size + count) capacity *= 2;
+      
+      uint8_t* data = (uint8_t*)JSON_REALLOC(b->data, (size_t)capacity);
+      if (!data) {
+        b->failed = 1;
+        return 0;
+      }
+      
+      b->data = data;
+      b->capacity = capacity;
+    }
+    
+    uint64_t offset = b->size;
+    memset(b->data + offset, 0, (size_t)count);
+    b->size += count;
+    
+    return offset;
+  }
+  
+  static uint64_t json_snapshot_add_string(JsonSnapshotBuilder* b, const json_char* str, uint32_t length) {
+    uint64_t offset = json_snapshot_reserve(b, ((uint64_t)length + 1) * sizeof(json_char));
+    if (!b->failed) memcpy(b->data + offset, str, ((size_t)length + 1) * sizeof(json_char));
+    
+    return offset;
+  }
+  
+  // Nodes are addressed by offset since the buffer may move while children are added
+  static void json_snapshot_add_value(JsonSnapshotBuilder* b, JsonValue* value, uint64_t node_offset) {
+    JsonSnapshotNode node = {};
+    node.type = value->type;
+    
+    switch (value->type) {
+      case JSON_NULL: {
+        break;
+      }
+      
+      case JSON_STRING: {
+        uint32_t length = (uint32_t)json_strlen(value->string_value);
+        node.count = length;
+        node.payload = json_snapshot_add_string(b, value->string_value, length);
+        break;
+      }
+      
+      case JSON_NUMBER:
+      case JSON_RAW_NUMBER: {
+        // Snapshots always store the converted value
+        double num = json_get_number(value);
+        node.type = JSON_NUMBER;
+        memcpy(&node.payload, &num, sizeof(double));
+        break;
+      }
+      
+      case JSON_OBJECT: {
+        uint32_t count = 0;
+        for (JsonObject* obj = value->object_value; obj != NULL; obj = obj->next) {
+          if (obj->key) ++count;
+        }
+        
+        uint64_t members = json_snapshot_reserve(b, (uint64_t)count * sizeof(JsonSnapshotMember));
+        
+        uint32_t i = 0;
+        for (JsonObject* obj = value->object_value; obj != NULL && !b->failed; obj = obj->next) {
+          if (!obj->key) continue;
+          
+          uint64_t member_offset = members + (uint64_t)i++ * sizeof(JsonSnapshotMember);
+          
+          uint32_t key_length;
+          uint32_t key_hash = json_hash_key(obj->key, &key_length);
+          uint64_t key = json_snapshot_add_string(b, obj->key, key_length);
+          if (b->failed) break;
+          
+          JsonSnapshotMember* member = (JsonSnapshotMember*)(b->data + member_offset);
+          member->key = key;
+          member->key_length = key_length;
+          member->key_hash = key_hash;
+          
+          json_snapshot_add_value(b, obj->value, member_offset + offsetof(JsonSnapshotMember, value));
+        }
+        
+        node.count = count;
+        node.payload = members;
+        break;
+      }
+      
+      case JSON_ARRAY: {
+        uint32_t count = value->array_value->count;
+        uint64_t elements = json_snapshot_reserve(b, (uint64_t)count * sizeof(JsonSnapshotNode));
+        
+        for (uint32_t i = 0; i < count && !b->failed; ++i) {
+          json_snapshot_add_value(b, &value->array_value->values[i], elements + (uint64_t)i * sizeof(JsonSnapshotNode));
+        }
+        
+        node.count = count;
+        node.payload = elements;
+        break;
+      }
+      
+      case JSON_NUMBER_ARRAY: {
+        // Stored as a regular array of numbers
+        uint32_t count = value->number_array_value->count;
+        uint64_t elements = json_snapshot_reserve(b, (uint64_t)count * sizeof(JsonSnapshotNode));
+        
+        for (uint32_t i = 0; i < count && !b->failed; ++i) {
+          JsonSnapshotNode element = {};
+          element.type = JSON_NUMBER;
+          
+          double num = json_number_array_get(value, i);
+          memcpy(&element.payload, &num, sizeof(double));
+          memcpy(b->data + elements + (uint64_t)i * sizeof(JsonSnapshotNode), &element, sizeof(JsonSnapshotNode));
+        }
+        
+        node.type = JSON_ARRAY;
+        node.count = count;
+        node.payload = elements;
+        break;
+      }
+      
+      case JSON_BOOL: {
+        node.payload = (value->bool_value) ? 1 : 0;
+        break;
+      }
+    }
     
-    return json;
+    if (!b->failed) memcpy(b->data + node_offset, &node, sizeof(JsonSnapshotNode));
   }
   
-  inline JsonValue json_string_char(json_char value) {
-    JsonValue json  = {};
-    json.type = JSON_STRING;
-    json.string_value = (json_char*)json_alloc(2 * sizeof(json_char));
-    json.string_value[0] = value;
-    json.string_value[1] = JSTR('\0');
+  uint8_t* json_snapshot_build(JsonValue* json, uint64_t* size) {
+    if (!json) return NULL;
     
-    return json;
-  }
-  
-  static inline JsonObject* json_alloc_object(const json_char* key, JsonValue value) {
-    JsonObject* object_value = (JsonObject*)json_alloc(sizeof(JsonObject)); 
-    object_value->key = (json_char*)json_alloc(((uint32_t)json_strlen(key) + 1) * sizeof(json_char));
-    json_strcpy(object_value->key, key);
+    JsonSnapshotBuilder b = {};
+    json_snapshot_reserve(&b, sizeof(JsonSnapshotHeader));
+    json_snapshot_add_value(&b, json, offsetof(JsonSnapshotHeader, root));
     
-    object_value->value = (JsonValue*)json_alloc(sizeof(JsonValue));
-    *object_value->value = value;
+    if (b.failed) {
+      if (b.data) JSON_FREE(b.data);
+      return NULL;
+    }
     
-    return object_value;
+    JsonSnapshotHeader* header = (JsonSnapshotHeader*)b.data;
+    header->magic = JSON_SNAPSHOT_MAGIC;
+    header->version = JSON_SNAPSHOT_VERSION;
+    header->endian = JSON_SNAPSHOT_ENDIAN;
+    header->char_size = sizeof(json_char);
+    header->size = b.size;
+    
+    if (size) *size = b.size;
+    return b.data;
   }
   
-  inline JsonValue json_object() {
-    JsonValue json  = {};
-    json.type = JSON_OBJECT;
+  json_bool json_snapshot_write(JsonValue* json, const char* path) {
+    if (!json || !path) return 0;
     
-    return json;
+    uint64_t size;
+    uint8_t* data = json_snapshot_build(json, &size);
+    if (!data) return 0;
+    
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+      printf("Could not create file for writing '%s'\n", path);
+      JSON_FREE(data);
+      return 0;
+    }
+    
+    json_bool ok = fwrite(data, (size_t)size, 1, file) == 1;
+    fclose(file);
+    
+    JSON_FREE(data);
+    return ok;
   }
   
-  inline void json_add_field(JsonValue* json, const json_char* key, JsonValue value) {
-    assert(json->type == JSON_OBJECT);
+  json_bool json_snapshot_open(JsonSnapshot* snapshot, const void* data, uint64_t size) {
+    memset(snapshot, 0, sizeof(JsonSnapshot));
     
-    if (!json->object_value) {
-      json->object_value = json_alloc_object(key, value);
-    } else {
-      JsonObject* curr = json->object_value;
-      for (;;) {
-        if (curr->next) {
-          curr = curr->next;
-        } else {
-          curr->next = json_alloc_object(key, value);
-          break;
-        }
-      }
+    const JsonSnapshotHeader* header = (const JsonSnapshotHeader*)data;
+    if (!data || size < sizeof(JsonSnapshotHeader) ||
+        header->magic != JSON_SNAPSHOT_MAGIC ||
+        header->version != JSON_SNAPSHOT_VERSION ||
+        header->endian != JSON_SNAPSHOT_ENDIAN ||
+        header->char_size != sizeof(json_char) ||
+        header->size > size) {
+      return 0;
     }
+    
+    snapshot->base = (const uint8_t*)data;
+    snapshot->size = header->size;
+    
+    return 1;
   }
   
-  inline JsonValue json_array() {
-    JsonValue json  = {};
-    json.type = JSON_ARRAY;
+  json_bool json_snapshot_map(JsonSnapshot* snapshot, const char* path) {
+    memset(snapshot, 0, sizeof(JsonSnapshot));
     
-    json.array_value = (JsonArray*)json_alloc(sizeof(JsonArray));
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+      printf("Could not open file '%s'\n", path);
+      return 0;
+    }
     
-    return json;
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return 0;
+    
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return 0;
+    
+    uint64_t size = (uint64_t)file_size.QuadPart;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+      printf("Could not open file '%s'\n", path);
+      return 0;
+    }
+    
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size == 0) {
+      close(file);
+      return 0;
+    }
+    
+    uint64_t size = (uint64_t)info.st_size;
+    void* view = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (view == MAP_FAILED) return 0;
+#endif
+    
+    if (!json_snapshot_open(snapshot, view, size)) {
+      printf("'%s' is not a valid snapshot\n", path);
+      
+#ifdef _WIN32
+      UnmapViewOfFile(view);
+#else
+      munmap(view, (size_t)size);
+#endif
+      return 0;
+    }
+    
+    snapshot->mapping = view;
+    snapshot->mapping_size = size;
+    
+    return 1;
   }
   
-  inline void json_add_element(JsonValue* json, JsonValue value) {
-    // @HARDCODED
-    const int ARRAY_START_SIZE = 32;
-    
-    if (!json->array_value->values) {
-      json->array_value->capacity = ARRAY_START_SIZE;
-      json->array_value->values = (JsonValue*)json_alloc(sizeof(JsonValue) * json->array_value->capacity);
-    } else if (json->array_value->count >= json->array_value->capacity) {
-      // Double the capacity
-      json->array_value->capacity *= 2;
-      json->array_value->values = (JsonValue*)JSON_REALLOC(json->array_value->values,
-                                                           sizeof(JsonValue) * json->array_value->capacity);
+  void json_snapshot_unmap(JsonSnapshot* snapshot) {
+    if (snapshot->mapping) {
+#ifdef _WIN32
+      UnmapViewOfFile(snapshot->mapping);
+#else
+      munmap(snapshot->mapping, (size_t)snapshot->mapping_size);
+#endif
     }
     
-    json->array_value->values[json->array_value->count++] = value;
+    memset(snapshot, 0, sizeof(JsonSnapshot));
   }
   
-  inline void json_remove_element(JsonValue* json, uint32_t index) {
-    if (index >= json->array_value->count || !json->array_value->values) return;
+  const JsonSnapshotNode* json_snapshot_root(const JsonSnapshot* snapshot) {
+    if (!snapshot->base) return NULL;
     
-    // Free the value
-    json_free(&json->array_value->values[index]);
+    return &((const JsonSnapshotHeader*)snapshot->base)->root;
+  }
+  
+  const json_char* json_snapshot_string(const JsonSnapshot* snapshot, const JsonSnapshotNode* node) {
+    if (!node || node->type != JSON_STRING) return NULL;
     
-    // If it's the last element, just decrease the count
-    if (index == json->array_value->count - 1) {
-      --json->array_value->count;
-    } else {
-      // Else, copy everything after it over it
-      memcpy(json->array_value->values + index, json->array_value->values + (index + 1),
-             (json->array_value->count-- - index) * sizeof(JsonValue));
-    }
+    return (const json_char*)(snapshot->base + node->payload);
   }
   
-  inline JsonValue json_boolean(json_bool value) {
-    JsonValue json = {};
-    json.type = JSON_BOOL;
-    json.bool_value = value;
-    return json;
+  double json_snapshot_number(const JsonSnapshotNode* node) {
+    double num = 0.0;
+    if (node && node->type == JSON_NUMBER) memcpy(&num, &node->payload, sizeof(double));
+    
+    return num;
   }
   
-  static void json_read(JsonContext* c, uint32_t count) {
-    if (c->curr + count <= c->len) {
-      json_strncpy(c->buffer, (c->text + c->curr), count);
-      c->curr += count;
-      c->buffer[count] = JSTR('\0');
-    } else {
-      c->buffer[0] = JSTR('\0');
-      c->is_parsing = 0;
-    }
+  json_bool json_snapshot_bool(const JsonSnapshotNode* node) {
+    return node && node->type == JSON_BOOL && node->payload != 0;
   }
   
-  static json_char json_get(JsonContext* c) {
-    // Get next json_character, skip any whitespace
-    do {
-      json_read(c, 1);
-    } while (isspace(c->buffer[0]));
+  const JsonSnapshotNode* json_snapshot_element(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index) {
+    if (!node || node->type != JSON_ARRAY || index >= node->count) return NULL;
     
-    return c->buffer[0];
+    return (const JsonSnapshotNode*)(snapshot->base + node->payload) + index;
   }
   
-  static json_char json_peek(JsonContext* c) {
-    json_char peek = json_get(c);
-    c->curr--;
+  const json_char* json_snapshot_key(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index) {
+    if (!node || node->type != JSON_OBJECT || index >= node->count) return NULL;
     
-    return peek;
+    const JsonSnapshotMember* member = (const JsonSnapshotMember*)(snapshot->base + node->payload) + index;
+    return (const json_char*)(snapshot->base + member->key);
   }
   
-  static double json_parse_number(JsonContext* c) {
-    uint64_t num_start = c->curr;
+  const JsonSnapshotNode* json_snapshot_value(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, uint32_t index) {
+    if (!node || node->type != JSON_OBJECT || index >= node->count) return NULL;
     
-    // Consume negate
-    if (json_peek(c) == JSTR('-')) {
-      json_read(c, 1);
-    }
+    return &((const JsonSnapshotMember*)(snapshot->base + node->payload) + index)->value;
+  }
+  
+  const JsonSnapshotNode* json_snapshot_get_field(const JsonSnapshot* snapshot, const JsonSnapshotNode* node, const json_char* key) {
+    if (!node || !key || node->type != JSON_OBJECT) return NULL;
     
-    // Parse integer part
-    json_bool exponent_found = 0;
-    int radix_count = 0;
-    do {
-      json_read(c, 1);
-      
-      if (c->buffer[0] == JSTR('.')) {
-        ++radix_count;
-        continue;
+    uint32_t key_length;
+    uint32_t key_hash = json_hash_key(key, &key_length);
+    
+    const JsonSnapshotMember* members = (const JsonSnapshotMember*)(snapshot->base + node->payload);
+    for (uint32_t i = 0; i < node->count; ++i) {
+      const JsonSnapshotMember* member = &members[i];
+      if (member->key_hash == key_hash && member->key_length == key_length &&
+          json_strcmp(key, (const json_char*)(snapshot->base + member->key)) == 0) {
+        return &member->value;
       }
+    }
+    
+    return NULL;
+  }
+  
+  // Queries
+  
+  static json_bool json_query_add(JsonQuery* q, JsonQuerySegment* segment, uint32_t* capacity) {
+    if (q->count >= *capacity) {
+      *capacity = (*capacity) ? *capacity * 2 : 8;
       
-      if (c->buffer[0] == JSTR('e') ||
-          c->buffer[0] == JSTR('E')) {
-        exponent_found = 1;
-        break;
-      }
-    } while (isdigit(c->buffer[0]) ||
-             (c->buffer[0] == JSTR('.') && radix_count == 1));
+      JsonQuerySegment* segments = (JsonQuerySegment*)JSON_REALLOC(q->segments, sizeof(JsonQuerySegment) * *capacity);
+      if (!segments) return 0;
+      q->segments = segments;
+    }
     
-    uint64_t num_end = c->curr - 1;
+    if (segment->key) segment->key_hash = json_hash_key(segment->key, NULL);
+    q->segments[q->count++] = *segment;
     
-    uint32_t num_length = (uint32_t)(num_end - num_start);
-    c->curr = num_start;
-    json_read(c, num_length);
+    return 1;
+  }
+  
+  static json_char* json_query_copy_key(const json_char* start, uint32_t length) {
+    json_char* key = (json_char*)JSON_MALLOC((length + 1) * sizeof(json_char));
+    memcpy(key, start, length * sizeof(json_char));
+    key[length] = JSTR('\0');
+    
+    return key;
+  }
+  
+  // Parses an optionally negative integer, returns the number of characters read
+  static uint32_t json_query_parse_int(const json_char* p, int64_t* out) {
+    const json_char* start = p;
     
-    double num;
-    json_scanf(c->buffer, JSTR("%lf"), &num);
+    json_bool negative = (*p == JSTR('-'));
+    if (negative) ++p;
     
-    // Parse exponent
-    if (exponent_found) {
-      // Consume 'e' token
-      json_read(c, 1);
+    if (!isdigit(*p)) return 0;
+    
+    int64_t value = 0;
+    while (isdigit(*p)) {
+      value = value * 10 + (*p++ - JSTR('0'));
+    }
+    
+    *out = (negative) ? -value : value;
+    return (uint32_t)(p - start);
+  }
+  
+  static json_bool json_query_compile_pointer(JsonQuery* q, const json_char* path, uint32_t* capacity) {
+    const json_char* p = path;
+    
+    while (*p == JSTR('/')) {
+      ++p;
       
-      json_char sign = json_peek(c);
+      const json_char* start = p;
+      while (*p && *p != JSTR('/')) ++p;
       
-      json_bool is_positive = 1;
-      if (sign == '+') {
-        json_read(c, 1);
-        is_positive = 1;
-      } else if (sign == '-') {
-        is_positive = 0;
-        json_read(c, 1);
-      }
+      JsonQuerySegment segment = {};
+      segment.type = JSON_QUERY_MEMBER;
+      segment.key = json_query_copy_key(start, (uint32_t)(p - start));
       
-      num_start = c->curr;
-      radix_count = 0;
-      do {
-        json_read(c, 1);
-        
-#ifdef JSON_ALLOW_EXP_DECIMALS
-        if (c->buffer[0] == JSTR('.')) {
-          ++radix_count;
-          continue;
-        }
-#else
-        // If we don't allow it (which is by default)
-        // break when we see one, so we don't reach the
-        // while statement's check and pass it as valid.
-        if (c->buffer[0] == JSTR('.')) {
-          break;
+      // Unescape ~1 and ~0 in place
+      json_char* out = segment.key;
+      for (json_char* in = segment.key; *in; ++in) {
+        if (*in == JSTR('~') && in[1] == JSTR('1')) {
+          *out++ = JSTR('/');
+          ++in;
+        } else if (*in == JSTR('~') && in[1] == JSTR('0')) {
+          *out++ = JSTR('~');
+          ++in;
+        } else {
+          *out++ = *in;
         }
-#endif
-      } while (isdigit(c->buffer[0]) ||
-               (c->buffer[0] == JSTR('.') && radix_count == 1));
-      
-      num_end = c->curr;
-      
-      num_length = (uint32_t)(num_end - num_start);
-      
-      c->curr = num_start;
-      json_read(c, num_length);
+      }
+      *out = JSTR('\0');
       
-      double exp_num;
-      json_scanf(c->buffer, JSTR("%lf"), &exp_num);
+      segment.start = json_pointer_index(segment.key);
       
-      if (!is_positive) {
-        exp_num *= -1.0;
+      if (!json_query_add(q, &segment, capacity)) {
+        JSON_FREE(segment.key);
+        return 0;
       }
-      num *= pow(10.0, exp_num);
     }
     
-    return num;
+    return *p == JSTR('\0');
   }
   
-  static json_char* json_parse_string(JsonContext* c) {
-    // Consume starting quote
-    json_read(c, 1);
-    
-    // Remember file position
-    uint64_t string_start = c->curr;
+  static json_bool json_query_compile_path(JsonQuery* q, const json_char* path, uint32_t* capacity) {
+    // Skip the $
+    const json_char* p = path + 1;
     
-    // Calculate string length
-    uint32_t string_length = 0;
-    do {
-      json_read(c, 1);
+    while (*p) {
+      JsonQuerySegment segment = {};
       
-      if (c->buffer[0] == JSTR('\\')) {
-        json_read(c, 1);
+      if (*p == JSTR('.')) {
+        ++p;
         
-        switch (c->buffer[0]) {
-          case JSTR('"'):
-          case JSTR('\\'):
-          case JSTR('/'):
-          case JSTR('b'):
-          case JSTR('f'):
-          case JSTR('n'):
-          case JSTR('r'):
-          case JSTR('t'): 
-          case JSTR('u'): {
-            // Only 1 json_character
-            ++string_length;
-            break;
-          }
+        if (*p == JSTR('*')) {
+          segment.type = JSON_QUERY_WILDCARD;
+          ++p;
+        } else {
+          const json_char* start = p;
+          while (*p && *p != JSTR('.') && *p != JSTR('[')) ++p;
+          if (p == start) return 0;
           
-          default: {
-            string_length += 2;
-          }
+          segment.type = JSON_QUERY_KEY;
+          segment.key = json_query_copy_key(start, (uint32_t)(p - start));
         }
-      } else {
-        if (c->buffer[0] == JSTR('"')) break;
-        ++string_length;
-      }
-    } while (c->is_parsing);
-    
-    json_char* str = (json_char*)json_alloc((string_length + 1) * sizeof(json_char));
-    c->curr = string_start;
-    
-    // Calculate string length
-    int curr = 0;
-    do {
-      json_read(c, 1);
-      
-      if (c->buffer[0] == JSTR('\\')) {
-        json_read(c, 1);
+      } else if (*p == JSTR('[')) {
+        ++p;
         
-        switch (c->buffer[0]) {
-          case JSTR('"'):  str[curr++] = JSTR('\"'); break;
-          case JSTR('\\'): str[curr++] = JSTR('\\'); break;
-          case JSTR('/'):  str[curr++] = JSTR('/'); break;
-          case JSTR('b'):  str[curr++] = JSTR('\b'); break;
-          case JSTR('f'):  str[curr++] = JSTR('\f'); break;
-          case JSTR('n'):  str[curr++] = JSTR('\n'); break;
-          case JSTR('r'):  str[curr++] = JSTR('\r'); break;
-          case JSTR('t'):  str[curr++] = JSTR('\t'); break;
+        if (*p == JSTR('\'') || *p == JSTR('"')) {
+          json_char quote = *p++;
           
-          case JSTR('u'): {
-            // Read 4 hex digits
-            json_read(c, 4);
+          const json_char* start = p;
+          while (*p && *p != quote) ++p;
+          if (*p != quote) return 0;
+          
+          segment.type = JSON_QUERY_KEY;
+          segment.key = json_query_copy_key(start, (uint32_t)(p - start));
+          ++p;
+        } else if (*p == JSTR('*')) {
+          segment.type = JSON_QUERY_WILDCARD;
+          ++p;
+        } else {
+          segment.type = JSON_QUERY_INDEX;
+          segment.step = 1;
+          
+          uint32_t read = json_query_parse_int(p, &segment.start);
+          segment.has_start = (read > 0);
+          p += read;
+          
+          if (*p == JSTR(':')) {
+            segment.type = JSON_QUERY_SLICE;
+            ++p;
             
-            int valid = 0;
-            for (int i = 0; i < 4; ++i) {
-              json_char h = c->buffer[i];
-              valid += ((h >= JSTR('A') && h <= JSTR('F')) ||
-                        (h >= JSTR('a') && h <= JSTR('f')) ||
-                        isdigit(h));
-            }
+            read = json_query_parse_int(p, &segment.end);
+            segment.has_end = (read > 0);
+            p += read;
             
-            if (valid == 4) {
-              int hex_num;
-              json_scanf(c->buffer, JSTR("%x"), &hex_num);
-              
-              if (hex_num > JSON_CHAR_MAX) {
-                json_printf(JSTR("Warning: unicode codepoint \\u%s doesn't fit\n"), c->buffer);
-                json_printf(JSTR("    Decimal value: %d\n    Max value: %d\n"), hex_num, JSON_CHAR_MAX);
-                str[curr++] = JSTR('?');
-              } else {
-                str[curr++] = (json_char)hex_num;
-              }
-            } else {
-              for (int i = 0; i < 5; ++i) {
-                str[curr++] = c->buffer[i];
-              }
+            if (*p == JSTR(':')) {
+              ++p;
+              read = json_query_parse_int(p, &segment.step);
+              if (read == 0) segment.step = 1;
+              p += read;
             }
-            break;
-          }
-          
-          default: {
-            str[curr++] = c->buffer[0];
-            str[curr++] = c->buffer[1];
+          } else if (!segment.has_start) {
+            return 0;
           }
         }
-      } else {
-        if (c->buffer[0] == JSTR('"')) break;
         
-        str[curr++] = c->buffer[0];
+        if (*p != JSTR(']')) {
+          if (segment.key) JSON_FREE(segment.key);
+          return 0;
+        }
+        ++p;
+      } else {
+        return 0;
+      }
+      
+      if (!json_query_add(q, &segment, capacity)) {
+        if (segment.key) JSON_FREE(segment.key);
+        return 0;
       }
-    } while (c->is_parsing);
+    }
     
-    return str;
+    return 1;
   }
   
-  static void json_parse_value(JsonContext* c, JsonValue* value);
-  
-  static JsonArray* json_parse_array(JsonContext* c) {
-    // Consume tarting bracket
-    json_read(c, 1);
+  json_bool json_query_compile(JsonQuery* query, const json_char* path) {
+    memset(query, 0, sizeof(JsonQuery));
+    if (!path) return 0;
     
-    // @HARDCODED
-    const int ARRAY_START_SIZE = 32;
+    uint32_t capacity = 0;
+    json_bool ok;
     
-    JsonArray* arr = (JsonArray*)json_alloc(sizeof(JsonArray));
-    if (json_peek(c) != JSTR(']')) {
-      // Initial value
-      arr->capacity = ARRAY_START_SIZE;
-      arr->values = (JsonValue*)json_alloc(sizeof(JsonValue) * arr->capacity);
-      
-      while (1) {
-        if (arr->count >= arr->capacity) {
-          // Double the capacity
-          arr->capacity *= 2;
-          arr->values = (JsonValue*)JSON_REALLOC(arr->values, sizeof(JsonValue) * arr->capacity);
-        }
-        
-        json_parse_value(c, &arr->values[arr->count++]);
-        
-        json_char next = json_get(c);
-        
-        if (next == JSTR(']')) break;
-        if (next != JSTR(',')) {
-          json_printf(JSTR("Unknown token in array '%c'\n"), next);
-          break;
-        }
-      }
+    if (path[0] == JSTR('$')) {
+      ok = json_query_compile_path(query, path, &capacity);
     } else {
-      // Consume closing bracket
-      json_read(c, 1);
+      ok = json_query_compile_pointer(query, path, &capacity);
     }
     
-    return arr;
+    if (!ok) {
+      json_printf(JSTR("Invalid query '%s'\n"), path);
+      json_query_free(query);
+    }
+    
+    return ok;
   }
   
-  static json_bool json_parse_field(JsonContext* c, JsonObject* curr) {
-    JsonValue tmp  = {};
-    json_parse_value(c, &tmp);
+  void json_query_free(JsonQuery* query) {
+    for (uint32_t i = 0; i < query->count; ++i) {
+      if (query->segments[i].key) JSON_FREE(query->segments[i].key);
+    }
     
-    if (tmp.type != JSON_STRING) {
-      json_printf(JSTR("Object field must be string\n"));
-      json_free(&tmp);
-      return 0;
+    if (query->segments) JSON_FREE(query->segments);
+    memset(query, 0, sizeof(JsonQuery));
+  }
+  
+  static JsonValue* json_query_find_key(JsonValue* json, const JsonQuerySegment* segment) {
+    if (json->type != JSON_OBJECT) return NULL;
+    
+    for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+      if (obj->key && obj->key_hash == segment->key_hash && json_strcmp(obj->key, segment->key) == 0) {
+        return obj->value;
+      }
     }
     
-    curr->key = tmp.string_value;
+    return NULL;
+  }
+  
+  // Normalizes slice bounds like RFC 9535 does
+  static void json_query_slice_bounds(const JsonQuerySegment* segment, int64_t count, int64_t* lower, int64_t* upper) {
+    int64_t start, end;
     
-    if (json_get(c) != JSTR(':')) {
-      json_printf(JSTR("Expected ':' in object\n"));
-      return 0;
+    if (segment->step >= 0) {
+      start = (segment->has_start) ? segment->start : 0;
+      end = (segment->has_end) ? segment->end : count;
+    } else {
+      start = (segment->has_start) ? segment->start : count - 1;
+      end = (segment->has_end) ? segment->end : -count - 1;
     }
     
-    curr->value = (JsonValue*)json_alloc(sizeof(JsonValue));
-    json_parse_value(c, curr->value);
-    return 1;
+    if (start < 0) start += count;
+    if (end < 0) end += count;
+    
+    if (segment->step >= 0) {
+      *lower = (start < 0) ? 0 : (start > count) ? count : start;
+      *upper = (end < 0) ? 0 : (end > count) ? count : end;
+    } else {
+      *upper = (start < -1) ? -1 : (start > count - 1) ? count - 1 : start;
+      *lower = (end < -1) ? -1 : (end > count - 1) ? count - 1 : end;
+    }
   }
   
-  static JsonObject* json_parse_object(JsonContext* c) {
-    // Consume starting brace
-    json_read(c, 1);
+  static json_bool json_query_eval(const JsonQuery* q, uint32_t depth, JsonValue* json,
+                                   JsonQueryCallback callback, void* user, uint32_t* matches) {
+    if (depth == q->count) {
+      ++*matches;
+      return callback(user, json);
+    }
     
-    JsonObject* head = (JsonObject*)json_alloc(sizeof(JsonObject));
-    JsonObject* prev = head;
+    const JsonQuerySegment* segment = &q->segments[depth];
     
-    if (json_peek(c) != JSTR('}')) {
-      json_parse_field(c, head);
+    switch (segment->type) {
+      case JSON_QUERY_MEMBER: {
+        if (json->type == JSON_ARRAY) {
+          if (segment->start < 0 || segment->start >= json->array_value->count) return 1;
+          return json_query_eval(q, depth + 1, &json->array_value->values[segment->start], callback, user, matches);
+        }
+        
+        JsonValue* value = json_query_find_key(json, segment);
+        return (value) ? json_query_eval(q, depth + 1, value, callback, user, matches) : 1;
+      }
       
-      json_char next = json_get(c);
-      if (next == JSTR('}') || next != JSTR(',')) {
-        if (next != JSTR('}') && next != JSTR(',')) {
-          json_printf(JSTR("Unknown token in object '%c'\n"), next);
+      case JSON_QUERY_KEY: {
+        JsonValue* value = json_query_find_key(json, segment);
+        return (value) ? json_query_eval(q, depth + 1, value, callback, user, matches) : 1;
+      }
+      
+      case JSON_QUERY_INDEX: {
+        if (json->type != JSON_ARRAY) return 1;
+        
+        int64_t count = json->array_value->count;
+        int64_t index = (segment->start < 0) ? segment->start + count : segment->start;
+        if (index < 0 || index >= count) return 1;
+        
+        return json_query_eval(q, depth + 1, &json->array_value->values[index], callback, user, matches);
+      }
+      
+      case JSON_QUERY_WILDCARD: {
+        if (json->type == JSON_ARRAY) {
+          for (uint32_t i = 0; i < json->array_value->count; ++i) {
+            if (!json_query_eval(q, depth + 1, &json->array_value->values[i], callback, user, matches)) return 0;
+          }
+        } else if (json->type == JSON_OBJECT) {
+          for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
+            if (!obj->key) continue;
+            if (!json_query_eval(q, depth + 1, obj->value, callback, user, matches)) return 0;
+          }
         }
-        return head;
+        
+        return 1;
       }
       
-      while (1) {
-        JsonObject* curr = (JsonObject*)json_alloc(sizeof(JsonObject));
+      case JSON_QUERY_SLICE: {
+        if (json->type != JSON_ARRAY || segment->step == 0) return 1;
         
-        if (!json_parse_field(c, curr)) break;
+        int64_t lower, upper;
+        json_query_slice_bounds(segment, json->array_value->count, &lower, &upper);
         
-        prev->next = curr;
-        prev = curr;
+        if (segment->step > 0) {
+          for (int64_t i = lower; i < upper; i += segment->step) {
+            if (!json_query_eval(q, depth + 1, &json->array_value->values[i], callback, user, matches)) return 0;
+          }
+        } else {
+          for (int64_t i = upper; i > lower; i += segment->step) {
+            if (!json_query_eval(q, depth + 1, &json->array_value->values[i], callback, user, matches)) return 0;
+          }
+        }
         
-        next = json_get(c);
-        if (next == JSTR('}')) break;
-        if (next != JSTR(',')) {
-          json_printf(JSTR("Unknown token in object '%c'\n"), next);
+        return 1;
+      }
+    }
+    
+    return 1;
+  }
+  
+  static json_bool json_query_store_first(void* user, JsonValue* value) {
+    *(JsonValue**)user = value;
+    return 0;
+  }
+  
+  JsonValue* json_query_first(const JsonQuery* query, JsonValue* json) {
+    if (!query || !json) return NULL;
+    
+    JsonValue* result = NULL;
+    uint32_t matches = 0;
+    json_query_eval(query, 0, json, json_query_store_first, &result, &matches);
+    
+    return result;
+  }
+  
+  uint32_t json_query_each(const JsonQuery* query, JsonValue* json, JsonQueryCallback callback, void* user) {
+    if (!query || !json || !callback) return 0;
+    
+    uint32_t matches = 0;
+    json_query_eval(query, 0, json, callback, user, &matches);
+    
+    return matches;
+  }
+  
+  // Filtered parsing
+  
+  typedef struct {
+    // Bit i of the active masks stands for queries[i], there are at most 64
+    const JsonQuery* queries;
+    uint32_t query_count;
+    JsonFilterCallback callback;
+    void* user;
+    
+    uint32_t matches;
+    json_bool stopped;
+    
+    // Called instead of building the value when a query ends, the callback is unused then
+    void (*visit)(JsonContext* c, void* user);
+  } JsonFilter;
+  
+  typedef struct {
+    JsonFilter* filter;
+    uint32_t query_index;
+  } JsonFilterMatch;
+  
+  static void json_skip_whitespace(JsonContext* c) {
+    while (c->curr < c->len) {
+      json_char ch = c->text[c->curr];
+      
+      if (ch == JSTR(' ') || ch == JSTR('\t') || ch == JSTR('\n') || ch == JSTR('\r')) {
+        ++c->curr;
+#ifdef JSON_ALLOW_COMMENTS
+      } else if (ch == JSTR('#')) {
+        while (c->curr < c->len && c->text[c->curr] != JSTR('\n')) ++c->curr;
+#endif
+      } else {
+        break;
+      }
+    }
+  }
+  
+  // Skips over a value by only matching quotes and brackets, nothing is validated or allocated
+  static void json_skip_value(JsonContext* c) {
+    json_skip_whitespace(c);
+    if (c->curr >= c->len) return;
+    
+    json_char ch = c->text[c->curr];
+    if (ch != JSTR('{') && ch != JSTR('[') && ch != JSTR('"')) {
+      // Numbers and literals end at the next delimiter
+      while (c->curr < c->len) {
+        ch = c->text[c->curr];
+        if (ch == JSTR(',') || ch == JSTR('}') || ch == JSTR(']') || ch == JSTR(' ') ||
+            ch == JSTR('\t') || ch == JSTR('\n') || ch == JSTR('\r') || ch == JSTR('#')) {
           break;
         }
+        ++c->curr;
       }
-    } else {
-      // Consume closing bracket
-      json_read(c, 1);
+      return;
     }
     
-    return head;
+    uint32_t depth = 0;
+    do {
+      ch = c->text[c->curr++];
+      
+      if (ch == JSTR('"')) {
+        while (c->curr < c->len) {
+          ch = c->text[c->curr++];
+          if (ch == JSTR('\\')) ++c->curr;
+          else if (ch == JSTR('"')) break;
+        }
+      } else if (ch == JSTR('{') || ch == JSTR('[')) {
+        ++depth;
+      } else if (ch == JSTR('}') || ch == JSTR(']')) {
+        --depth;
+#ifdef JSON_ALLOW_COMMENTS
+      } else if (ch == JSTR('#')) {
+        while (c->curr < c->len && c->text[c->curr] != JSTR('\n')) ++c->curr;
+#endif
+      }
+    } while (depth > 0 && c->curr < c->len);
+    
+    if (c->curr > c->len) c->curr = c->len;
   }
   
-#ifdef JSON_ALLOW_COMMENTS
-  static void json_parse_comment(JsonContext* c) {
-    // Consume #
-    json_read(c, 1);
+  static json_bool json_filter_emit(void* user, JsonValue* value) {
+    JsonFilterMatch* match = (JsonFilterMatch*)user;
+    JsonFilter* f = match->filter;
     
-    // Skip to newline
-    while (c->buffer[0] != JSTR('\n')) {
-      json_read(c, 1);
+    ++f->matches;
+    if (!f->callback(f->user, match->query_index, value)) {
+      f->stopped = 1;
+      return 0;
     }
     
-    // Consume \n
-    json_read(c, 1);
+    return 1;
   }
-#endif
   
-  static void json_parse_value(JsonContext* c, JsonValue* value) {
-    json_char peek = json_peek(c);
+  // Builds the value and evaluates the rest of every active query against it
+  static void json_filter_materialize(JsonContext* c, JsonFilter* f, uint32_t depth, uint64_t active) {
+    JsonValue value = {};
+    json_parse_value(c, &value);
     
-#ifdef JSON_ALLOW_COMMENTS
-    // Keep parsing comments
-    while (peek == JSTR('#')) {
-      json_parse_comment(c);
-      peek = json_peek(c);
+    for (uint32_t i = 0; active != 0 && !f->stopped; ++i, active >>= 1) {
+      if (!(active & 1)) continue;
+      
+      JsonFilterMatch match = { f, i };
+      uint32_t matches = 0;
+      json_query_eval(&f->queries[i], depth, &value, json_filter_emit, &match, &matches);
     }
-#endif
     
-    switch (peek) {
-      case JSTR('{'): {
-        value->type = JSON_OBJECT;
-        value->object_value = json_parse_object(c);
-        break;
+    json_free(&value);
+  }
+  
+  // Whether a segment needs to know the length of the array, which we don't while streaming
+  static json_bool json_filter_needs_count(const JsonQuerySegment* segment) {
+    if (segment->type == JSON_QUERY_INDEX) return segment->start < 0;
+    if (segment->type == JSON_QUERY_SLICE) {
+      return segment->step <= 0 ||
+        (segment->has_start && segment->start < 0) ||
+        (segment->has_end && segment->end < 0);
+    }
+    
+    return 0;
+  }
+  
+  static json_bool json_filter_matches_index(const JsonQuerySegment* segment, int64_t index) {
+    switch (segment->type) {
+      case JSON_QUERY_WILDCARD: return 1;
+      case JSON_QUERY_MEMBER:
+      case JSON_QUERY_INDEX: return segment->start == index;
+      case JSON_QUERY_SLICE: {
+        int64_t start = (segment->has_start) ? segment->start : 0;
+        return index >= start &&
+          (!segment->has_end || index < segment->end) &&
+          (index - start) % segment->step == 0;
       }
+      default: return 0;
+    }
+  }
+  
+  static json_bool json_filter_matches_key(const JsonQuerySegment* segment, const json_char* key,
+                                           uint32_t length, uint32_t hash) {
+    if (segment->type == JSON_QUERY_WILDCARD) return 1;
+    if (segment->type != JSON_QUERY_KEY && segment->type != JSON_QUERY_MEMBER) return 0;
+    
+    return segment->key_hash == hash &&
+      json_strlen(segment->key) == length &&
+      memcmp(segment->key, key, length * sizeof(json_char)) == 0;
+  }
+  
+  typedef struct {
+    const json_char* key;
+    uint32_t length;
+    uint32_t hash;
+    
+    // Only set if the key had escapes, free it after use
+    json_char* decoded;
+  } JsonFilterKey;
+  
+  // Reads a key and the ':' after it
+  static json_bool json_filter_read_key(JsonContext* c, JsonFilterKey* out) {
+    json_skip_whitespace(c);
+    if (c->curr >= c->len || c->text[c->curr] != JSTR('"')) {
+      json_printf(JSTR("Object field must be string\n"));
+      c->is_parsing = 0;
+      return 0;
+    }
+    
+    // Compare keys in place, only keys with escapes need to be decoded
+    out->key = c->text + c->curr + 1;
+    out->decoded = NULL;
+    
+    uint64_t end = c->curr + 1;
+    while (end < c->len && c->text[end] != JSTR('"') && c->text[end] != JSTR('\\')) ++end;
+    
+    if (end < c->len && c->text[end] == JSTR('"')) {
+      out->length = (uint32_t)(end - c->curr - 1);
+      c->curr = end + 1;
+    } else {
+      out->decoded = json_parse_string(c);
+      out->key = out->decoded;
+      out->length = (uint32_t)json_strlen(out->decoded);
+    }
+    
+    out->hash = 2166136261u;
+    for (uint32_t i = 0; i < out->length; ++i) {
+      out->hash = (out->hash ^ (uint32_t)out->key[i]) * 16777619u;
+    }
+    
+    json_skip_whitespace(c);
+    if (c->curr >= c->len || c->text[c->curr] != JSTR(':')) {
+      json_printf(JSTR("Expected ':' in object\n"));
+      if (out->decoded) json_mem_free(out->decoded);
+      c->is_parsing = 0;
+      return 0;
+    }
+    ++c->curr;
+    
+    return 1;
+  }
+  
+  static void json_filter_value(JsonContext* c, JsonFilter* f, uint32_t depth, uint64_t active);
+  
+  static void json_filter_object(JsonContext* c, JsonFilter* f, uint32_t depth, uint64_t active) {
+    // Consume starting brace
+    ++c->curr;
+    
+    json_skip_whitespace(c);
+    if (c->curr < c->len && c->text[c->curr] == JSTR('}')) {
+      ++c->curr;
+      return;
+    }
+    
+    while (c->is_parsing && !f->stopped) {
+      JsonFilterKey key;
+      if (!json_filter_read_key(c, &key)) return;
       
-      case JSTR('['): {
-        value->type = JSON_ARRAY;
-        value->array_value = json_parse_array(c);
-        break;
+      uint64_t next = 0;
+      for (uint32_t i = 0; i < f->query_count && (active >> i) != 0; ++i) {
+        if (((active >> i) & 1) &&
+            json_filter_matches_key(&f->queries[i].segments[depth], key.key, key.length, key.hash)) {
+          next |= (uint64_t)1 << i;
+        }
       }
       
-      case JSTR('"'): {
-        value->type = JSON_STRING;
-        value->string_value = json_parse_string(c);
-        break;
-      }
+      if (key.decoded) json_mem_free(key.decoded);
       
-      default: {
-        if (c->buffer[0] == JSTR('-') ||
-            isdigit(c->buffer[0])) {
-          value->type = JSON_NUMBER;
-          value->number_value = json_parse_number(c);
-        } else {
-          uint64_t word_start = c->curr;
-          uint32_t word_length = 0;
-          
-          do {
-            json_read(c, 1);
-            if (c->buffer[0] >= JSTR('a') && c->buffer[0] <= JSTR('z')) {
-              ++word_length;
-            } else {
-              break;
-            }
-          } while (1);
-          
-          c->curr = word_start;
-          json_read(c, word_length);
-          
-          if (json_strcmp(c->buffer, JSTR("true")) == 0) {
-            value->type = JSON_BOOL;
-            value->bool_value = 1;
-          } else if (json_strcmp(c->buffer, JSTR("false")) == 0) {
-            value->type = JSON_BOOL;
-            value->bool_value = 0;
-          } else if (json_strcmp(c->buffer, JSTR("null")) == 0) {
-            value->type = JSON_NULL;
-          } else {
-            json_printf(JSTR("Unknown token '%s'\n"), c->buffer);
-            c->is_parsing = 0;
-          }
+      json_filter_value(c, f, depth + 1, next);
+      
+      json_skip_whitespace(c);
+      json_char ch = (c->curr < c->len) ? c->text[c->curr++] : JSTR('\0');
+      if (ch == JSTR('}')) break;
+      if (ch != JSTR(',')) {
+        json_printf(JSTR("Unknown token in object '%c'\n"), ch);
+        c->is_parsing = 0;
+      }
+    }
+  }
+  
+  static void json_filter_array(JsonContext* c, JsonFilter* f, uint32_t depth, uint64_t active) {
+    for (uint32_t i = 0; i < f->query_count && (active >> i) != 0; ++i) {
+      if (((active >> i) & 1) && json_filter_needs_count(&f->queries[i].segments[depth])) {
+        json_filter_materialize(c, f, depth, active);
+        return;
+      }
+    }
+    
+    // Consume starting bracket
+    ++c->curr;
+    
+    json_skip_whitespace(c);
+    if (c->curr < c->len && c->text[c->curr] == JSTR(']')) {
+      ++c->curr;
+      return;
+    }
+    
+    for (int64_t index = 0; c->is_parsing && !f->stopped; ++index) {
+      uint64_t next = 0;
+      for (uint32_t i = 0; i < f->query_count && (active >> i) != 0; ++i) {
+        if (((active >> i) & 1) &&
+            json_filter_matches_index(&f->queries[i].segments[depth], index)) {
+          next |= (uint64_t)1 << i;
         }
       }
+      
+      json_filter_value(c, f, depth + 1, next);
+      
+      json_skip_whitespace(c);
+      json_char ch = (c->curr < c->len) ? c->text[c->curr++] : JSTR('\0');
+      if (ch == JSTR(']')) break;
+      if (ch != JSTR(',')) {
+        json_printf(JSTR("Unknown token in array '%c'\n"), ch);
+        c->is_parsing = 0;
+      }
     }
   }
   
-  JsonValue json_parse_from_file(const char* path) {
-    FILE* file = fopen(path, JSON_READ_MODE);
-    
-    if (!file) {
-      printf("Could not open file '%s'\n", path);
-      
-      JsonValue dummy  = {};
-      return dummy;
+  static void json_filter_value(JsonContext* c, JsonFilter* f, uint32_t depth, uint64_t active) {
+    if (active == 0) {
+      json_skip_value(c);
+      return;
     }
     
-    fseek(file, 0, SEEK_END);
-    uint64_t size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    json_char* json_text = (json_char*)json_alloc(((u32)size + 1) * sizeof(json_char));
-    
-    json_char* cursor = json_text;
-    while (!feof(file)) {
-      json_fgets(cursor, (int)size, file);
-      cursor = json_text + json_strlen(json_text);
+    // Any query that ends here needs the whole value
+    for (uint32_t i = 0; i < f->query_count && (active >> i) != 0; ++i) {
+      if (((active >> i) & 1) && f->queries[i].count == depth) {
+        if (f->visit) f->visit(c, f->user);
+        else json_filter_materialize(c, f, depth, active);
+        return;
+      }
     }
     
-    fclose(file);
-    
-    JsonValue value = json_parse(json_text);
-    
-    JSON_FREE(json_text);
+    json_skip_whitespace(c);
+    json_char ch = (c->curr < c->len) ? c->text[c->curr] : JSTR('\0');
     
-    return value;
+    if (ch == JSTR('{')) {
+      json_filter_object(c, f, depth, active);
+    } else if (ch == JSTR('[')) {
+      json_filter_array(c, f, depth, active);
+    } else {
+      json_skip_value(c);
+    }
   }
   
-  JsonValue json_parse(const json_char* json_text) {
+  uint32_t json_parse_filtered(const json_char* json_text, const JsonQuery* queries, uint32_t query_count,
+                               JsonFilterCallback callback, void* user) {
+    if (!json_text || !queries || !callback || query_count == 0) return 0;
+    
+    if (query_count > 64) {
+      json_printf(JSTR("Can't filter more than 64 queries at once\n"));
+      return 0;
+    }
+    
     JsonContext c  = {};
     c.is_parsing = 1;
     
-    // @TODO: right now we're ignoring the byte-order mark
-    // Can we get away with that?
     const int BOM_CHAR = 65279;
     if (JSON_CHAR_MAX >= BOM_CHAR && json_text[0] == BOM_CHAR) {
       ++json_text;
@@ -918,257 +8346,354 @@ extern "C" {
     c.text = json_text;
     c.len = json_strlen(c.text);
     
-    JsonValue value  = {};
-    json_parse_value(&c, &value);
+    JsonFilter f = {};
+    f.queries = queries;
+    f.query_count = query_count;
+    f.callback = callback;
+    f.user = user;
     
-    return value;
+    uint64_t active = (query_count == 64) ? UINT64_MAX : (((uint64_t)1 << query_count) - 1);
+    json_filter_value(&c, &f, 0, active);
+    
+    return f.matches;
   }
   
-  static void json_print_indent(json_char* out, int out_size, json_bool minified, int indent_level) {
-    if (!minified) {
-      for (int i = 0; i < indent_level; ++i) {
-        json_sprintf(out, out_size, JSTR("%s%c"), out, JSON_INDENT_CHAR);
-      }
-    }
+  // Columnar extraction
+  
+  typedef struct {
+    JsonColumn* columns;
+    uint32_t column_count;
+    uint32_t* hashes;
+    uint32_t* lengths;
+    
+    uint32_t rows;
+    uint32_t capacity;
+    json_bool failed;
+  } JsonColumnBuilder;
+  
+  static void* json_column_grow(void* data, uint64_t size) {
+    return (data) ? JSON_REALLOC(data, size) : JSON_MALLOC(size);
   }
   
-  static void json_print_newline(json_char* out, int out_size, json_bool minified) {
-    if (!minified) {
-      json_sprintf(out, out_size, JSTR("%s\n"), out);
-    }
+  static json_bool json_column_reserve_blob(JsonColumn* col, uint64_t count) {
+    if (col->blob_size + count <= col->blob_capacity) return 1;
+    
+    uint64_t capacity = (col->blob_capacity) ? col->blob_capacity : 256;
+    while (capacity < col->blob_size + count) capacity *= 2;
+    
+    json_char* blob = (json_char*)json_column_grow(col->blob, capacity * sizeof(json_char));
+    if (!blob) return 0;
+    
+    col->blob = blob;
+    col->blob_capacity = capacity;
+    return 1;
   }
   
-  static void json_stringify(JsonValue* value, json_char* out, int out_size, int indent_level, json_bool minified) {
-    switch (value->type) {
-      case JSON_NULL: {
-        json_sprintf(out, out_size, JSTR("%snull"), out);
-        break;
-      }
-      
-      case JSON_STRING: {
-        json_sprintf(out, out_size, JSTR("%s\"%s\""), out, value->string_value);
-        break;
-      }
-      
-      case JSON_NUMBER: {
-        // Check if number has a decimal place
-        if (fmod(value->number_value, 1.0) == 0.0) {
-          if (value->number_value > 0.0) {
-            json_sprintf(out, out_size, JSTR("%s%" PRIu64), out, (uint64_t)value->number_value);
-          } else {
-            json_sprintf(out, out_size, JSTR("%s%" PRId64), out, (int64_t)value->number_value);
-          }
-        } else {
-          json_sprintf(out, out_size, JSTR("%s%.6g"), out, value->number_value);
-        }
-        break;
-      }
+  // Adds an empty, invalid row to every column
+  static json_bool json_column_add_row(JsonColumnBuilder* b) {
+    if (b->rows == b->capacity) {
+      // @HARDCODED
+      uint32_t capacity = (b->capacity) ? b->capacity * 2 : 1024;
       
-      case JSON_OBJECT: {
-        json_sprintf(out, out_size, JSTR("%s{"), out);
-        json_print_newline(out, out_size, minified);
-        
-        if (value->object_value) {
-          for (JsonObject* obj = value->object_value; obj != NULL; obj = obj->next) {
-            json_print_indent(out, out_size, minified, indent_level);
-            json_sprintf(out, out_size, JSTR("%s\"%s\":%s"),
-                         out, obj->key, (minified == 0) ? JSTR(" ") : JSTR(""));
-            json_stringify(obj->value, out, out_size, indent_level + JSON_INDENT_STEP, minified);
-            
-            if (obj->next) {
-              json_sprintf(out, out_size, JSTR("%s,"), out);
-              json_print_newline(out, out_size, minified);
-            } else {
-              json_print_newline(out, out_size, minified);
-            }
-          }
+      for (uint32_t i = 0; i < b->column_count; ++i) {
+        JsonColumn* col = &b->columns[i];
+        
+        uint8_t* valid = (uint8_t*)json_column_grow(col->valid, capacity);
+        if (!valid) return 0;
+        col->valid = valid;
+        
+        void* values = NULL;
+        switch (col->type) {
+          case JSON_COLUMN_NUMBER: values = json_column_grow(col->numbers, (uint64_t)capacity * sizeof(double)); break;
+          case JSON_COLUMN_INT64: values = json_column_grow(col->integers, (uint64_t)capacity * sizeof(int64_t)); break;
+          case JSON_COLUMN_BOOL: values = json_column_grow(col->bools, capacity); break;
+          case JSON_COLUMN_STRING: values = json_column_grow(col->offsets, ((uint64_t)capacity + 1) * sizeof(uint64_t)); break;
         }
-        indent_level -= JSON_INDENT_STEP;
-        json_print_indent(out, out_size, minified, indent_level);
-        json_sprintf(out, out_size, JSTR("%s}"), out);
-        break;
-      }
-      
-      case JSON_ARRAY: {
-        json_sprintf(out, out_size, JSTR("%s["), out);
-        json_print_newline(out, out_size, minified);
+        if (!values) return 0;
         
-        for (int i = 0; i < (int)value->array_value->count; ++i) {
-          json_print_indent(out, out_size, minified, indent_level);
-          json_stringify(&value->array_value->values[i], out, out_size, indent_level + JSON_INDENT_STEP, minified);
-          
-          if (i + 1 < (int)value->array_value->count) {
-            json_sprintf(out, out_size, JSTR("%s,"), out);
-            json_print_newline(out, out_size, minified);
-          } else {
-            json_print_newline(out, out_size, minified);
+        switch (col->type) {
+          case JSON_COLUMN_NUMBER: col->numbers = (double*)values; break;
+          case JSON_COLUMN_INT64: col->integers = (int64_t*)values; break;
+          case JSON_COLUMN_BOOL: col->bools = (uint8_t*)values; break;
+          case JSON_COLUMN_STRING: {
+            col->offsets = (uint64_t*)values;
+            if (b->capacity == 0) col->offsets[0] = 0;
+            break;
           }
         }
-        indent_level -= JSON_INDENT_STEP;
-        json_print_indent(out, out_size, minified, indent_level);
-        json_sprintf(out, out_size, JSTR("%s]"), out);
-        break;
       }
       
-      case JSON_BOOL: {
-        json_sprintf(out, out_size, JSTR("%s%s"), out, (value->bool_value) ? JSTR("true") : JSTR("false"));
-        break;
-      }
+      b->capacity = capacity;
     }
-  }
-  
-  json_bool json_export(JsonValue* json, const char* path, json_bool minified) {
-    if (!json || !path) return 0;
-    
-    FILE* file = fopen(path, JSON_WRITE_MODE);
     
-    if (!file) {
-      printf("Could not create file for writing '%s'\n", path);
-      return 0;
+    uint32_t row = b->rows++;
+    for (uint32_t i = 0; i < b->column_count; ++i) {
+      JsonColumn* col = &b->columns[i];
+      col->valid[row] = 0;
+      
+      switch (col->type) {
+        case JSON_COLUMN_NUMBER: col->numbers[row] = 0.0; break;
+        case JSON_COLUMN_INT64: col->integers[row] = 0; break;
+        case JSON_COLUMN_BOOL: col->bools[row] = 0; break;
+        case JSON_COLUMN_STRING: {
+          // Empty string until the field is found
+          if (!json_column_reserve_blob(col, 1)) return 0;
+          col->blob[col->blob_size++] = JSTR('\0');
+          col->offsets[row + 1] = col->blob_size;
+          break;
+        }
+      }
     }
     
-    int out_size = UINT16_MAX * sizeof(json_char); // @HARDCODED
-    json_char* out = (json_char*)json_alloc(out_size);
-    json_stringify(json, out, out_size, JSON_INDENT_STEP, minified);
-    
-    fwrite(out, json_strlen(out) * sizeof(json_char), 1, file);
-    fflush(file);
-    fclose(file);
-    
-    JSON_FREE(out);
-    
     return 1;
   }
   
-  JsonValue* json_get_field(JsonValue* json, const json_char* key) {
-    if (!json || !key || json->type != JSON_OBJECT) return NULL;
-    
-    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
-      if (json_strcmp(key, v->key) == 0) {
-        return v->value;
-      }
-    }
+  static json_bool json_column_matches_literal(JsonContext* c, const json_char* literal, uint32_t length) {
+    if (c->curr + length > c->len) return 0;
     
-    return NULL;
-  }
-  
-#ifdef __cplusplus
-  
-  JsonValue& json_get_field_ref(JsonValue* json, const json_char* key) {
-    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
-      if (json_strcmp(key, v->key) == 0) {
-        return *v->value;
-        break;
-      }
+    for (uint32_t i = 0; i < length; ++i) {
+      if (c->text[c->curr + i] != literal[i]) return 0;
     }
     
-    JsonValue dummy = json_null();
-    return dummy;
+    return 1;
   }
   
-#endif
-  
-  int json_field_count(JsonValue* json, const json_char* key) {
-    int count = 0;
-    
-    for (JsonObject* v = json->object_value; v != NULL; v = v->next) {
-      if (json_strcmp(key, v->key) == 0) {
-        ++count;
-      }
-    }
+  // Reads a field of the current row straight into its column, anything else is skipped
+  static void json_column_read_value(JsonContext* c, JsonColumnBuilder* b, JsonColumn* col) {
+    uint32_t row = b->rows - 1;
     
-    return count;
-  }
-  
-  void json_free(JsonValue* json) {
-    if (!json) return;
+    json_skip_whitespace(c);
+    if (c->curr >= c->len) return;
     
-    switch (json->type) {
-      case JSON_STRING: {
-        JSON_FREE(json->string_value);
-        break;
-      }
-      
-      case JSON_OBJECT: {
-        // Get latest node
+    json_char ch = c->text[c->curr];
+    switch (col->type) {
+      case JSON_COLUMN_NUMBER:
+      case JSON_COLUMN_INT64: {
+        const json_char* literal = c->text + c->curr;
+        uint32_t length = (ch == JSTR('-') || json_is_digit(ch)) ? json_number_length(literal) : 0;
+        if (length == 0) break;
         
-        JsonObject* head = json->object_value;
-        JsonObject* tmp;
-        
-        while (head) {
-          tmp = head;
-          head = head->next;
-          
-          JSON_FREE(tmp->key);
-          json_free(tmp->value);
-          JSON_FREE(tmp->value);
-          JSON_FREE(tmp);
+        if (col->type == JSON_COLUMN_NUMBER) {
+          col->numbers[row] = json_number_from_text(literal, length);
+        } else if (json_is_integer_literal(literal, length)) {
+          col->integers[row] = (int64_t)json_strtoll(literal, NULL, 10);
+        } else {
+          col->integers[row] = (int64_t)json_number_from_text(literal, length);
         }
         
-        break;
+        col->valid[row] = 1;
+        c->curr += length;
+        return;
       }
       
-      case JSON_ARRAY: {
-        for (int i = 0; i < (int)json->array_value->count; ++i) {
-          json_free(&json->array_value->values[i]);
+      case JSON_COLUMN_BOOL: {
+        if (json_column_matches_literal(c, JSTR("true"), 4)) {
+          col->bools[row] = 1;
+          col->valid[row] = 1;
+          c->curr += 4;
+          return;
+        }
+        
+        if (json_column_matches_literal(c, JSTR("false"), 5)) {
+          col->bools[row] = 0;
+          col->valid[row] = 1;
+          c->curr += 5;
+          return;
         }
-        JSON_FREE(json->array_value->values);
-        JSON_FREE(json->array_value);
         break;
       }
       
-      case JSON_NULL:
-      case JSON_NUMBER:
-      case JSON_BOOL: {
-        break;
+      case JSON_COLUMN_STRING: {
+        if (ch != JSTR('"')) break;
+        
+        // Overwrite the empty string added by json_column_add_row()
+        col->blob_size = col->offsets[row];
+        
+        uint64_t end = c->curr + 1;
+        while (end < c->len && c->text[end] != JSTR('"') && c->text[end] != JSTR('\\')) ++end;
+        
+        const json_char* str = c->text + c->curr + 1;
+        json_char* decoded = NULL;
+        uint64_t length;
+        
+        // Copy straight from the text unless there are escapes
+        if (end < c->len && c->text[end] == JSTR('"')) {
+          length = end - c->curr - 1;
+          c->curr = end + 1;
+        } else {
+          decoded = json_parse_string(c);
+          str = decoded;
+          length = json_strlen(decoded);
+        }
+        
+        if (json_column_reserve_blob(col, length + 1)) {
+          memcpy(col->blob + col->blob_size, str, length * sizeof(json_char));
+          col->blob_size += length;
+          col->blob[col->blob_size++] = JSTR('\0');
+          col->valid[row] = 1;
+        } else {
+          col->blob[col->blob_size++] = JSTR('\0');
+          b->failed = 1;
+        }
+        col->offsets[row + 1] = col->blob_size;
+        
+        if (decoded) json_mem_free(decoded);
+        return;
       }
     }
     
-    *json = json_null();
+    json_skip_value(c);
   }
   
-  JsonValue json_duplicate(JsonValue* json) {
-    if (!json) return json_null();
+  static void json_column_read_row(JsonContext* c, JsonColumnBuilder* b) {
+    if (!json_column_add_row(b)) {
+      b->failed = 1;
+      c->is_parsing = 0;
+      return;
+    }
     
-    switch (json->type) {
-      case JSON_NULL: {
-        return json_null();
-      }
+    json_skip_whitespace(c);
+    if (c->curr >= c->len || c->text[c->curr] != JSTR('{')) {
+      // Rows that aren't objects stay invalid
+      json_skip_value(c);
+      return;
+    }
+    
+    // Consume starting brace
+    ++c->curr;
+    
+    json_skip_whitespace(c);
+    if (c->curr < c->len && c->text[c->curr] == JSTR('}')) {
+      ++c->curr;
+      return;
+    }
+    
+    while (c->is_parsing) {
+      JsonFilterKey key;
+      if (!json_filter_read_key(c, &key)) return;
       
-      case JSON_STRING: {
-        return json_string(json->string_value);
+      JsonColumn* col = NULL;
+      for (uint32_t i = 0; i < b->column_count; ++i) {
+        if (b->hashes[i] == key.hash && b->lengths[i] == key.length &&
+            memcmp(b->columns[i].name, key.key, key.length * sizeof(json_char)) == 0) {
+          col = &b->columns[i];
+          break;
+        }
       }
       
-      case JSON_NUMBER: {
-        return json_number(json->number_value);
-      }
+      if (key.decoded) json_mem_free(key.decoded);
       
-      case JSON_OBJECT: {
-        JsonValue dup = json_object();
-        
-        for (JsonObject* obj = json->object_value; obj != NULL; obj = obj->next) {
-          json_add_field(&dup, obj->key, json_duplicate(obj->value));
-        }
-        
-        return dup;
-      }
+      if (col) json_column_read_value(c, b, col);
+      else json_skip_value(c);
       
-      case JSON_ARRAY: {
-        JsonValue dup = json_array();
-        
-        for (int i = 0; i < (int)json->array_value->count; ++i) {
-          json_add_element(&dup, json_duplicate(&json->array_value->values[i]));
-        }
-        
-        return dup;
+      json_skip_whitespace(c);
+      json_char ch = (c->curr < c->len) ? c->text[c->curr++] : JSTR('\0');
+      if (ch == JSTR('}')) break;
+      if (ch != JSTR(',')) {
+        json_printf(JSTR("Unknown token in object '%c'\n"), ch);
+        c->is_parsing = 0;
       }
+    }
+  }
+  
+  // Visits an array that matched the rows query
+  static void json_column_visit(JsonContext* c, void* user) {
+    JsonColumnBuilder* b = (JsonColumnBuilder*)user;
+    
+    json_skip_whitespace(c);
+    if (c->curr >= c->len || c->text[c->curr] != JSTR('[')) {
+      json_skip_value(c);
+      return;
+    }
+    
+    // Consume starting bracket
+    ++c->curr;
+    
+    json_skip_whitespace(c);
+    if (c->curr < c->len && c->text[c->curr] == JSTR(']')) {
+      ++c->curr;
+      return;
+    }
+    
+    while (c->is_parsing) {
+      json_column_read_row(c, b);
       
-      case JSON_BOOL: {
-        return json_boolean(json->bool_value);
+      json_skip_whitespace(c);
+      json_char ch = (c->curr < c->len) ? c->text[c->curr++] : JSTR('\0');
+      if (ch == JSTR(']')) break;
+      if (ch != JSTR(',')) {
+        json_printf(JSTR("Unknown token in array '%c'\n"), ch);
+        c->is_parsing = 0;
       }
     }
+  }
+  
+  uint32_t json_parse_columns(const json_char* json_text, const JsonQuery* rows, JsonColumn* columns, uint32_t column_count) {
+    if (!json_text || !rows || !columns || column_count == 0) return 0;
     
-    return json_null();
+    for (uint32_t i = 0; i < rows->count; ++i) {
+      if (json_filter_needs_count(&rows->segments[i])) {
+        json_printf(JSTR("Negative indices and slices aren't supported for columns\n"));
+        return 0;
+      }
+    }
+    
+    JsonColumnBuilder b = {};
+    b.columns = columns;
+    b.column_count = column_count;
+    b.hashes = (uint32_t*)JSON_MALLOC(column_count * sizeof(uint32_t));
+    b.lengths = (uint32_t*)JSON_MALLOC(column_count * sizeof(uint32_t));
+    
+    for (uint32_t i = 0; i < column_count; ++i) {
+      b.hashes[i] = json_hash_key(columns[i].name, &b.lengths[i]);
+    }
+    
+    JsonContext c  = {};
+    c.is_parsing = 1;
+    
+    const int BOM_CHAR = 65279;
+    if (JSON_CHAR_MAX >= BOM_CHAR && json_text[0] == BOM_CHAR) {
+      ++json_text;
+    }
+    
+    c.text = json_text;
+    c.len = json_strlen(c.text);
+    
+    JsonFilter f = {};
+    f.queries = rows;
+    f.query_count = 1;
+    f.user = &b;
+    f.visit = json_column_visit;
+    
+    json_filter_value(&c, &f, 0, 1);
+    
+    JSON_FREE(b.hashes);
+    JSON_FREE(b.lengths);
+    
+    if (b.failed) {
+      json_printf(JSTR("Out of memory while extracting columns\n"));
+    }
+    
+    return b.rows;
+  }
+  
+  void json_columns_free(JsonColumn* columns, uint32_t column_count) {
+    if (!columns) return;
+    
+    for (uint32_t i = 0; i < column_count; ++i) {
+      JsonColumn* col = &columns[i];
+      
+      if (col->valid) JSON_FREE(col->valid);
+      if (col->numbers) JSON_FREE(col->numbers);
+      if (col->offsets) JSON_FREE(col->offsets);
+      if (col->blob) JSON_FREE(col->blob);
+      
+      const json_char* name = col->name;
+      JsonColumnType type = col->type;
+      memset(col, 0, sizeof(JsonColumn));
+      col->name = name;
+      col->type = type;
+    }
   }
   
 #ifdef __cplusplus
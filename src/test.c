@@ -0,0 +1,338 @@
+
+#define JSON_IMPLEMENTATION
+// #define JSON_USE_SINGLE_BYTE
+#include "json.h"
+
+// Behaviour checks, every failure is printed and the exit code is how many there were:
+//   g++ -x c++ -pthread src/test.c && ./a.out
+//   gcc -std=gnu99 -fgnu89-inline -pthread src/test.c -lm && ./a.out
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+static void check(int passed, const char* what, int line) {
+  if (!passed) {
+    fprintf(stderr, "test.c:%d: failed %s\n", line, what);
+    ++failures;
+  }
+}
+
+// Lazy numbers
+
+static void test_lazy_duplicate(void) {
+  json_char text[] = JSTR("{\"big\": 12345678901, \"list\": [1.25, -2e3]}");
+  
+  JsonValue json = json_parse_ex(text, JSON_PARSE_LAZY_NUMBERS);
+  CHECK(json_get_field(&json, JSTR("big"))->type == JSON_RAW_NUMBER);
+  
+  // The copy has to survive both the original and its text
+  JsonValue copy = json_duplicate(&json);
+  json_free(&json);
+  for (uint32_t i = 0; text[i]; ++i) text[i] = JSTR('0');
+  
+  JsonValue* big = json_get_field(&copy, JSTR("big"));
+  CHECK(big->type == JSON_NUMBER && json_get_int64(big) == 12345678901LL);
+  
+  JsonValue* list = json_get_field(&copy, JSTR("list"))->array_value->values;
+  CHECK(list[0].type == JSON_NUMBER && json_get_number(&list[0]) == 1.25);
+  CHECK(list[1].type == JSON_NUMBER && json_get_number(&list[1]) == -2000);
+  
+  json_free(&copy);
+}
+
+// Patches
+
+// Applying json_diff(from, to) to a copy of from has to give to
+static void check_diff(const json_char* from_text, const json_char* to_text, uint32_t flags, int line) {
+  JsonValue from = json_parse_ex(from_text, flags);
+  JsonValue to = json_parse_ex(to_text, flags);
+  
+  JsonValue patch = json_diff(&from, &to);
+  JsonValue copy = json_duplicate(&from);
+  check(json_apply_patch(&copy, &patch) && json_equals(&copy, &to), "diff round trip", line);
+  
+  json_free(&from);
+  json_free(&to);
+  json_free(&patch);
+  json_free(&copy);
+}
+
+static void check_patch(const json_char* text, const json_char* patch_text, const json_char* expected_text, int line) {
+  JsonValue json = json_parse(text);
+  JsonValue patch = json_parse(patch_text);
+  JsonValue expected = json_parse(expected_text);
+  
+  check(json_apply_patch(&json, &patch) && json_equals(&json, &expected), "patch", line);
+  
+  json_free(&json);
+  json_free(&patch);
+  json_free(&expected);
+}
+
+static void test_patch(void) {
+  check_diff(JSTR("{\"a\": 1, \"b\": [1, 2, 3, 4, 5], \"c\": {\"d\": \"x\"}}"),
+             JSTR("{\"a\": 2, \"b\": [1, 9, 3, 5, 6], \"c\": {\"e\": \"x\"}, \"f\": null}"), 0, __LINE__);
+  check_diff(JSTR("[{\"id\": 1}, {\"id\": 2}, {\"id\": 3}]"), JSTR("[{\"id\": 2}, {\"id\": 3}, {\"id\": 1}]"), 0, __LINE__);
+  check_diff(JSTR("[\"a\", \"b\", \"c\", \"d\"]"), JSTR("[\"d\", \"c\", \"b\", \"a\"]"), 0, __LINE__);
+  check_diff(JSTR("[1, 2, 3]"), JSTR("[0, 1, 2, 3, 4]"), JSON_PARSE_NUMBER_ARRAYS, __LINE__);
+  check_diff(JSTR("{\"a/b\": 1, \"c~d\": 2}"), JSTR("{\"a/b\": 3}"), 0, __LINE__);
+  check_diff(JSTR("{}"), JSTR("{\"x\": {\"y\": []}}"), 0, __LINE__);
+  check_diff(JSTR("[1, 2]"), JSTR("[]"), 0, __LINE__);
+  check_diff(JSTR("1"), JSTR("[1]"), 0, __LINE__);
+  
+  check_patch(JSTR("{\"a\": {\"b\": [1, 2]}}"),
+              JSTR("[{\"op\": \"add\", \"path\": \"/a/b/-\", \"value\": 3},"
+                   " {\"op\": \"replace\", \"path\": \"/a/b/0\", \"value\": 0},"
+                   " {\"op\": \"move\", \"from\": \"/a/b\", \"path\": \"/c\"},"
+                   " {\"op\": \"test\", \"path\": \"/c/2\", \"value\": 3}]"),
+              JSTR("{\"a\": {}, \"c\": [0, 2, 3]}"), __LINE__);
+  
+  // Operations before the one that fails stay applied
+  JsonValue json = json_parse(JSTR("{\"a\": 1}"));
+  JsonValue patch = json_parse(JSTR("[{\"op\": \"remove\", \"path\": \"/a\"}, {\"op\": \"remove\", \"path\": \"/a\"}]"));
+  CHECK(!json_apply_patch(&json, &patch) && json_get_field(&json, JSTR("a")) == NULL);
+  json_free(&json);
+  json_free(&patch);
+  
+  JsonValue merged = json_parse(JSTR("{\"a\": {\"b\": 1, \"c\": 2}}"));
+  JsonValue merge = json_parse(JSTR("{\"a\": {\"b\": null, \"d\": 3}}"));
+  JsonValue expected = json_parse(JSTR("{\"a\": {\"c\": 2, \"d\": 3}}"));
+  json_apply_merge_patch(&merged, &merge);
+  CHECK(json_equals(&merged, &expected));
+  json_free(&merged);
+  json_free(&merge);
+  json_free(&expected);
+}
+
+// Streams
+
+// Hands out the text a few bytes at a time, or fails once fail_at bytes were read
+typedef struct {
+  const char* text;
+  uint64_t size;
+  uint64_t position;
+  uint64_t piece;
+  uint64_t fail_at;
+} TestReader;
+
+static int64_t test_read(void* user, void* buffer, uint64_t size) {
+  TestReader* reader = (TestReader*)user;
+  if (reader->position >= reader->fail_at) return -1;
+  
+  uint64_t count = reader->size - reader->position;
+  if (count > reader->piece) count = reader->piece;
+  if (count > size) count = size;
+  
+  memcpy(buffer, reader->text + reader->position, (size_t)count);
+  reader->position += count;
+  return (int64_t)count;
+}
+
+// Adds up the numbers in the values it's handed, lazy ones would be skipped
+static json_bool test_sum(void* user, JsonValue* value) {
+  double* sum = (double*)user;
+  if (value->type == JSON_NUMBER) *sum += value->number_value;
+  
+  JsonValue* field = json_get_field(value, JSTR("a"));
+  if (field && field->type == JSON_NUMBER) *sum += field->number_value;
+  
+  return 1;
+}
+
+static void check_stream(const char* text, uint32_t flags, uint64_t count, double sum, json_bool ok, uint64_t fail_at, int line) {
+  const uint64_t pieces[] = { 1, 3, 4096 };
+  
+  for (uint32_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); ++i) {
+    TestReader reader = { text, strlen(text), 0, pieces[i], fail_at };
+    double streamed_sum = 0;
+    json_bool streamed_ok = 2;
+    
+    uint64_t streamed = json_parse_stream(test_read, &reader, flags, test_sum, &streamed_sum, &streamed_ok);
+    check(streamed == count && streamed_sum == sum && streamed_ok == ok, "stream", line);
+  }
+}
+
+static void test_stream(void) {
+  const uint64_t never = (uint64_t)-1;
+  const uint32_t modes[] = { 0, JSON_STREAM_THREADED };
+  
+  for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    uint32_t mode = modes[i];
+    
+    check_stream("1 2.5 {\"a\": 3} \"x\" 4", mode, 5, 10.5, 1, never, __LINE__);
+    check_stream("1 2.5 {\"a\": 3} \"x\" 4", mode | JSON_PARSE_LAZY_NUMBERS, 5, 10.5, 1, never, __LINE__);
+    check_stream("[1, {\"a\": 2}, 3]", mode | JSON_STREAM_ELEMENTS, 3, 6, 1, never, __LINE__);
+    check_stream("", mode, 0, 0, 1, never, __LINE__);
+    
+    // Truncated input, values up to the error are handed out and ok is 0
+    check_stream("1 2 {\"a\": 3", mode, 2, 3, 0, never, __LINE__);
+    check_stream("1 \"ab", mode, 1, 1, 0, never, __LINE__);
+    check_stream("1 tru", mode, 1, 1, 0, never, __LINE__);
+    check_stream("[1, 2", mode | JSON_STREAM_ELEMENTS, 2, 3, 0, never, __LINE__);
+    
+    // Values that don't parse stop the stream
+    check_stream("1 {\"a\": oops} 2", mode, 1, 1, 0, never, __LINE__);
+    check_stream("{}", mode | JSON_STREAM_ELEMENTS, 0, 0, 0, never, __LINE__);
+    
+    // So does a read that fails
+    check_stream("1 2 3", mode, 0, 0, 0, 0, __LINE__);
+  }
+}
+
+// Incremental reparsing
+
+// The edited document and its spans have to be the same as if the text was parsed from scratch
+static void check_editor(JsonEditor* editor, int line) {
+  JsonEditor fresh;
+  json_editor_init(&fresh, editor->text, editor->flags);
+  
+  int same = (fresh.valid == editor->valid);
+  if (same && fresh.valid) {
+    JsonValue parsed = json_parse_ex(editor->text, editor->flags);
+    same = json_equals(&editor->root, &parsed) && json_equals(&editor->root, &fresh.root) &&
+           fresh.spans.count == editor->spans.count;
+    json_free(&parsed);
+    
+    for (uint32_t i = 0; same && i < fresh.spans.count; ++i) {
+      JsonSpan a = fresh.spans.data[i];
+      JsonSpan b = editor->spans.data[i];
+      same = a.start == b.start && a.end == b.end && a.parent == b.parent && a.index == b.index;
+    }
+  }
+  
+  check(same, "edit matches a full parse", line);
+  json_editor_free(&fresh);
+}
+
+// Offset of the first occurrence of what in the editor's text
+static uint64_t test_find(JsonEditor* editor, const json_char* what) {
+  uint64_t length = json_strlen(what);
+  for (uint64_t i = 0; i + length <= editor->length; ++i) {
+    if (json_strncmp(editor->text + i, what, (size_t)length) == 0) return i;
+  }
+  return editor->length;
+}
+
+static JsonValue* test_replace(JsonEditor* editor, const json_char* what, const json_char* text) {
+  return json_editor_replace(editor, test_find(editor, what), json_strlen(what), text, json_strlen(text));
+}
+
+static void test_editor(void) {
+  const uint32_t modes[] = { 0, JSON_PARSE_NUMBER_ARRAYS };
+  
+  for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+    JsonEditor editor;
+    CHECK(json_editor_init(&editor, JSTR("{\"servers\": [{\"host\": \"a\", \"port\": 80, \"tags\": [\"x\"]}, {\"host\": \"b\", \"port\": 81}],"
+                                         " \"limits\": {\"cpu\": [1, 2, 3], \"mem\": {\"soft\": 1, \"hard\": 2}}}"), modes[i]));
+    check_editor(&editor, __LINE__);
+    
+    // Edits inside a container only reparse that container
+    JsonValue* changed = test_replace(&editor, JSTR("80"), JSTR("8080"));
+    CHECK(changed && changed != &editor.root && changed->type == JSON_OBJECT);
+    check_editor(&editor, __LINE__);
+    
+    changed = test_replace(&editor, JSTR("3]"), JSTR("3, 4]"));
+    CHECK(changed && changed != &editor.root);
+    check_editor(&editor, __LINE__);
+    
+    test_replace(&editor, JSTR("\"x\""), JSTR("\"x\", \"]{\""));
+    check_editor(&editor, __LINE__);
+    
+    test_replace(&editor, JSTR(", \"hard\": 2"), JSTR(""));
+    check_editor(&editor, __LINE__);
+    
+    test_replace(&editor, JSTR("{\"host\": \"b\""), JSTR("{\"host\": \"b\", \"extra\": {\"deep\": [[]]}"));
+    check_editor(&editor, __LINE__);
+    
+    // Text that doesn't parse, then the edit that repairs it
+    test_replace(&editor, JSTR("\"soft\""), JSTR("soft\""));
+    CHECK(!editor.valid);
+    check_editor(&editor, __LINE__);
+    
+    test_replace(&editor, JSTR("soft\""), JSTR("\"soft\""));
+    CHECK(editor.valid);
+    check_editor(&editor, __LINE__);
+    
+    json_editor_free(&editor);
+  }
+  
+  // Only JSON whitespace can follow the document
+  JsonEditor spaced;
+  CHECK(json_editor_init(&spaced, JSTR("[1, 2] \t\r\n"), 0) && spaced.valid);
+  json_editor_free(&spaced);
+  
+  json_editor_init(&spaced, JSTR("[1, 2]\f"), 0);
+  CHECK(!spaced.valid);
+  json_editor_free(&spaced);
+}
+
+// Memory usage
+
+// Keeps track of how many allocations are alive, user points to the count
+static void* test_allocate(void* user, size_t size) {
+  void* ptr = malloc(size);
+  if (ptr) ++*(int64_t*)user;
+  return ptr;
+}
+
+static void* test_reallocate(void* user, void* ptr, size_t size) {
+  void* result = realloc(ptr, size);
+  if (!ptr && result) ++*(int64_t*)user;
+  return result;
+}
+
+static void test_deallocate(void* user, void* ptr) {
+  if (ptr) --*(int64_t*)user;
+  free(ptr);
+}
+
+static void test_memory(void) {
+  int64_t live = 0;
+  JsonAllocator counting = { test_allocate, test_reallocate, test_deallocate, &live };
+  
+  const json_char* texts[] = {
+    JSTR("{}"),
+    JSTR("[1, \"x\", {\"a\": null}, [], {}]"),
+    JSTR("{\"e\": {}, \"f\": [{}, {\"g\": [1, 2, 3]}], \"h\": {\"i\": {}}}")
+  };
+  
+  for (uint32_t i = 0; i < sizeof(texts) / sizeof(texts[0]); ++i) {
+    JsonValue json = json_parse_with(texts[i], JSON_PARSE_NUMBER_ARRAYS, &counting);
+    
+    JsonMemoryUsage usage;
+    memset(&usage, 0, sizeof(usage));
+    json_memory_usage(&json, &usage);
+    CHECK(usage.allocations == (uint64_t)live);
+    
+    json_free_with(&json, &counting);
+    CHECK(live == 0);
+  }
+  
+  // A compacted copy of lazy numbers doesn't depend on the text either
+  json_char text[] = JSTR("{\"a\": [1.25, 12345678901], \"b\": 7}");
+  JsonValue json = json_parse_ex(text, JSON_PARSE_LAZY_NUMBERS);
+  
+  JsonCompactTree tree;
+  CHECK(json_compact(&tree, &json));
+  json_free(&json);
+  for (uint32_t i = 0; text[i]; ++i) text[i] = JSTR('0');
+  
+  JsonValue* a = json_get_field(&tree.root, JSTR("a"))->array_value->values;
+  CHECK(a[0].type == JSON_NUMBER && json_get_number(&a[0]) == 1.25);
+  CHECK(a[1].type == JSON_NUMBER && json_get_int64(&a[1]) == 12345678901LL);
+  CHECK(json_get_number(json_get_field(&tree.root, JSTR("b"))) == 7);
+  
+  json_compact_free(&tree);
+}
+
+int main() {
+  test_lazy_duplicate();
+  test_patch();
+  test_stream();
+  test_editor();
+  test_memory();
+  
+  fprintf(stderr, "%d failed\n", failures);
+  return failures;
+}